@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Matrix.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	// Axis aligned box, starts out empty (min above max) so the first Grow sets it to that point or box
+	struct BoundingBox
+	{
+		Vector3 min{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		Vector3 max{ std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+		bool IsEmpty() const
+		{
+			return min.x > max.x || min.y > max.y || min.z > max.z;
+		}
+
+		void Grow(const Vector3& point)
+		{
+			min = { std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z) };
+			max = { std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z) };
+		}
+
+		void Grow(const BoundingBox& box)
+		{
+			min = { std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z) };
+			max = { std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z) };
+		}
+
+		Vector3 GetCenter() const
+		{
+			return (min + max) * .5f;
+		}
+
+		Vector3 GetExtents() const
+		{
+			return (max - min) * .5f;
+		}
+
+		// Box around the transformed box, the center is transformed and every axis adds its extent scaled by the matrix (Arvo)
+		BoundingBox Transformed(const Matrix& matrix) const
+		{
+			if (IsEmpty())
+				return {};
+
+			const Vector3 center{ matrix.TransformPoint(GetCenter()) };
+			const Vector3 extents{ GetExtents() };
+
+			Vector3 transformedExtents{};
+			for (int column{}; column < 3; ++column)
+			{
+				for (int row{}; row < 3; ++row)
+					transformedExtents[column] += std::abs(matrix[row][column]) * extents[row];
+			}
+
+			return { center - transformedExtents, center + transformedExtents };
+		}
+	};
+}
@@ -0,0 +1,74 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	void Bvh::Build(std::span<const BoundingBox> boxes)
+	{
+		m_Nodes.clear();
+		m_Items.resize(boxes.size());
+		std::iota(m_Items.begin(), m_Items.end(), 0);
+
+		if (boxes.empty())
+		{
+			m_ItemBounds.clear();
+			return;
+		}
+
+		BuildNode(boxes, 0, static_cast<int>(boxes.size()));
+		Refit(boxes);
+	}
+
+	void Bvh::Refit(std::span<const BoundingBox> boxes)
+	{
+		m_ItemBounds.resize(m_Items.size());
+		for (size_t item{}; item < m_Items.size(); ++item)
+			m_ItemBounds[item] = boxes[m_Items[item]];
+
+		// Children come after their parent, so walking backwards refits them first
+		for (int index{ static_cast<int>(m_Nodes.size()) - 1 }; index >= 0; --index)
+		{
+			Node& node{ m_Nodes[index] };
+			node.bounds = {};
+
+			if (node.rightChild == 0)
+			{
+				for (int item{ node.firstItem }; item < node.firstItem + node.numItems; ++item)
+					node.bounds.Grow(m_ItemBounds[item]);
+			}
+			else
+			{
+				node.bounds.Grow(m_Nodes[index + 1].bounds);
+				node.bounds.Grow(m_Nodes[node.rightChild].bounds);
+			}
+		}
+	}
+
+	void Bvh::BuildNode(std::span<const BoundingBox> boxes, int firstItem, int numItems)
+	{
+		const int index{ static_cast<int>(m_Nodes.size()) };
+		m_Nodes.push_back({ {}, firstItem, numItems, 0 });
+
+		if (numItems <= m_MaxItemsPerLeaf)
+			return;
+
+		// Median split along the axis the box centers spread the most on
+		BoundingBox centerBounds{};
+		for (int item{ firstItem }; item < firstItem + numItems; ++item)
+			centerBounds.Grow(boxes[m_Items[item]].GetCenter());
+
+		const Vector3 spread{ centerBounds.max - centerBounds.min };
+		const int axis{ spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2) };
+
+		const int numLeftItems{ numItems / 2 };
+		std::nth_element(m_Items.begin() + firstItem, m_Items.begin() + firstItem + numLeftItems, m_Items.begin() + firstItem + numItems,
+			[&boxes, axis](int left, int right) { return boxes[left].GetCenter()[axis] < boxes[right].GetCenter()[axis]; });
+
+		BuildNode(boxes, firstItem, numLeftItems);
+		const int rightChild{ static_cast<int>(m_Nodes.size()) };
+		BuildNode(boxes, firstItem + numLeftItems, numItems - numLeftItems);
+		m_Nodes[index].rightChild = rightChild;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "BoundingBox.h"
+#include "Frustum.h"
+
+namespace dae
+{
+	// Bounding volume hierarchy over boxes, which are identified by their index in the span given to Build
+	// Build sorts the boxes into a tree, Refit only recomputes the node bounds for boxes that moved
+	// Refitting keeps queries exact but lets the tree get looser, rebuild when boxes move far or get added or removed
+	class Bvh final
+	{
+	public:
+		void Build(std::span<const BoundingBox> boxes);
+		// boxes must hold as many boxes as the last Build
+		void Refit(std::span<const BoundingBox> boxes);
+
+		// Calls visit(index) for every box that is not completely outside the frustum, in no particular order
+		template<typename Visit>
+		void Query(const Frustum& frustum, const Visit& visit) const
+		{
+			if (m_Nodes.empty())
+				return;
+
+			int stack[m_MaxDepth];
+			int stackSize{};
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0)
+			{
+				const Node& node{ m_Nodes[stack[--stackSize]] };
+
+				const Frustum::Containment containment{ frustum.Test(node.bounds) };
+				if (containment == Frustum::Containment::Outside)
+					continue;
+
+				// A subtree's items are contiguous, so a subtree that is completely inside needs no more tests
+				if (containment == Frustum::Containment::Inside || node.rightChild == 0)
+				{
+					for (int item{ node.firstItem }; item < node.firstItem + node.numItems; ++item)
+					{
+						if (containment == Frustum::Containment::Inside || frustum.Test(m_ItemBounds[item]) != Frustum::Containment::Outside)
+							visit(m_Items[item]);
+					}
+					continue;
+				}
+
+				stack[stackSize++] = node.rightChild;
+				stack[stackSize++] = static_cast<int>(&node - m_Nodes.data()) + 1;
+			}
+		}
+
+	private:
+		static constexpr int m_MaxItemsPerLeaf{ 4 };
+		// Halving splits, so enough for any number of boxes an int can count
+		static constexpr int m_MaxDepth{ 64 };
+
+		// Left child follows its parent, leaves have no right child
+		struct Node
+		{
+			BoundingBox bounds{};
+			int firstItem{};
+			int numItems{};
+			int rightChild{};
+		};
+
+		std::vector<Node> m_Nodes{};
+		// Box indices in tree order, with their boxes alongside so leaves test them without indirection
+		std::vector<int> m_Items{};
+		std::vector<BoundingBox> m_ItemBounds{};
+
+		void BuildNode(std::span<const BoundingBox> boxes, int firstItem, int numItems);
+	};
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <cassert>
+#include <limits>
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
 
@@ -34,6 +35,9 @@ namespace dae
 		float zNear{ .1f };
 		float zFar{ 100.f };
 
+		// Offset of the projection in NDC units, a subpixel shift per frame lets temporal upsampling gather detail between pixels
+		Vector2 jitter{};
+
 		float totalPitch{};
 		float totalYaw{};
 
@@ -64,7 +68,7 @@ namespace dae
 			};
 
 			//Inverse(ONB) => ViewMatrix
-			viewMatrix = invViewMatrix.Inverse();
+			viewMatrix = invViewMatrix.InverseAffine();
 
 			//ViewMatrix => Matrix::CreateLookAtLH(...) [not implemented yet]
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixlookatlh
@@ -73,25 +77,46 @@ namespace dae
 		void CalculateProjectionMatrix()
 		{
 			//TODO W3
-			
-			float near{ 0.1f };
-			float far{ 100 };
-
 			projectionMatrix = Matrix{
 				Vector4{1 / (aspectRatio * fov), 0, 0, 0},
 				Vector4{0, 1 / fov, 0, 0},
-				Vector4{0, 0, far / (far - near), 1},
-				Vector4{0, 0, -(far * near) / (far - near), 0}
+				Vector4{jitter.x, jitter.y, zFar / (zFar - zNear), 1},
+				Vector4{0, 0, -(zFar * zNear) / (zFar - zNear), 0}
 			};
 
 			//ProjectionMatrix => Matrix::CreatePerspectiveFovLH(...) [not implemented yet]
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
 		}
 
+		// Radius in pixels of a sphere on a screen screenHeight pixels high, infinite when the camera is inside it
+		// Taken as if the sphere were in the middle of the view, so turning the camera does not change it
+		float GetProjectedRadius(const Vector3& center, float radius, int screenHeight) const
+		{
+			const float sqrDistance{ (center - origin).SqrMagnitude() };
+			if (sqrDistance <= radius * radius)
+				return std::numeric_limits<float>::infinity();
+
+			// Tangent of the angle the sphere spans from its center, over the tangent of half the field of view
+			return radius / (std::sqrt(sqrDistance - radius * radius) * fov) * static_cast<float>(screenHeight) * .5f;
+		}
+
 		void Update(const Timer* pTimer)
 		{
-			const float deltaTime = pTimer->GetElapsed();
+			Update(pTimer->GetElapsed(), true);
+		}
 
+		void Update(float deltaTime, bool handleInput)
+		{
+			if (handleInput)
+				HandleInput(deltaTime);
+
+			//Update Matrices
+			CalculateViewMatrix();
+			CalculateProjectionMatrix(); //Try to optimize this - should only be called once or when fov/aspectRatio changes
+		}
+
+		void HandleInput(float deltaTime)
+		{
 			//Camera Update Logic
 			//...
 			//Add any additional keyboard input here (DOUBLECHECK BEFORE HAND-IN!!!)
@@ -176,10 +201,6 @@ namespace dae
 				forward = finalRotation.TransformVector(Vector3::UnitZ);
 				forward.Normalize();
 			}
-
-			//Update Matrices
-			CalculateViewMatrix();
-			CalculateProjectionMatrix(); //Try to optimize this - should only be called once or when fov/aspectRatio changes
 		}
 	};
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "BoundingBox.h"
 #include "Maths.h"
 #include "vector"
 
@@ -31,13 +32,57 @@ namespace dae
 		TriangleStrip
 	};
 
+	// Per-instance part of an instanced draw, the vertex data stays in the Mesh
+	struct MeshInstance
+	{
+		Matrix worldMatrix{};
+		// Multiplies the diffuse texture
+		ColorRGB tint{ colors::White };
+	};
+
+	// Cluster of at most MeshletBuilder::maxTriangles triangles of a mesh, culled as a whole before its vertices are transformed
+	struct Meshlet
+	{
+		// Into MeshLod::meshletVertices, which holds indices into Mesh::vertices
+		uint32_t firstVertex{};
+		uint32_t numVertices{};
+		// Into MeshLod::meshletTriangles, three meshlet vertex indices per triangle
+		uint32_t firstTriangle{};
+		uint32_t numTriangles{};
+
+		// Object space sphere around the vertices
+		Vector3 center{};
+		float radius{};
+		// Every face normal is within the cone around coneAxis, coneCutoff is the sine of its half angle
+		// A cutoff of 1 means the normals spread too far for the cluster to ever face away as a whole
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+	};
+
+	// One level of detail of a mesh, its triangles split into meshlets in submission order by MeshletBuilder::Build
+	struct MeshLod
+	{
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<uint8_t> meshletTriangles{};
+		uint32_t numTriangles{};
+		// About how far, in object space, the surface is away from the full mesh
+		float error{};
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleList };
+		// Object space box around the vertices, computed once at load time
+		BoundingBox bounds{};
 
-		std::vector<Vertex> vertices_out{};
-		Matrix worldMatrix{};
+		// Built at load time by MeshSimplifier::BuildLods, the full mesh first and then fewer triangles and a larger error with every level
+		// All of them index the vertices above
+		std::vector<MeshLod> lods{};
+
+		// The mesh is drawn once per instance, all of them share the vertices and indices above
+		std::vector<MeshInstance> instances{ MeshInstance{} };
 	};
 }
@@ -0,0 +1,114 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "JobSystem.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Blocks are aligned this much, allocations asking for more are not supported
+		constexpr size_t g_MaxAlignment{ alignof(std::max_align_t) > 64 ? alignof(std::max_align_t) : 64 };
+
+		std::byte* AllocateBlock(size_t size)
+		{
+			return static_cast<std::byte*>(::operator new(size, std::align_val_t{ g_MaxAlignment }));
+		}
+
+		void FreeBlock(std::byte* pBlock)
+		{
+			::operator delete(pBlock, std::align_val_t{ g_MaxAlignment });
+		}
+	}
+
+	LinearArena::LinearArena(size_t capacity) :
+		m_pBlock{ capacity ? AllocateBlock(capacity) : nullptr },
+		m_Capacity{ capacity }
+	{
+	}
+
+	LinearArena::~LinearArena()
+	{
+		Reset();
+		if (m_pBlock)
+			FreeBlock(m_pBlock);
+	}
+
+	void* LinearArena::Allocate(size_t size, size_t alignment)
+	{
+		assert(alignment <= g_MaxAlignment && "ERROR: alignment not supported by LinearArena!");
+
+		const size_t alignedOffset{ (m_Offset + alignment - 1) & ~(alignment - 1) };
+		if (alignedOffset + size <= m_Capacity)
+		{
+			m_Offset = alignedOffset + size;
+			return m_pBlock + alignedOffset;
+		}
+
+		// Counted as if it had been bump allocated, so the next Reset grows the block far enough
+		std::byte* pOverflow{ AllocateBlock(size ? size : 1) };
+		m_OverflowBlocks.push_back(pOverflow);
+		m_OverflowBytes += size + alignment;
+		++m_NumOverflows;
+
+		return pOverflow;
+	}
+
+	void LinearArena::Reset()
+	{
+		const size_t used{ m_Offset + m_OverflowBytes };
+		m_HighWater = std::max(m_HighWater, used);
+
+		for (std::byte* pOverflow : m_OverflowBlocks)
+			FreeBlock(pOverflow);
+		m_OverflowBlocks.clear();
+		m_OverflowBytes = 0;
+		m_NumOverflows = 0;
+		m_Offset = 0;
+
+		// Regrow with some headroom, so a slightly bigger frame doesn't overflow again right away
+		if (m_HighWater > m_Capacity)
+		{
+			if (m_pBlock)
+				FreeBlock(m_pBlock);
+
+			m_Capacity = m_HighWater + m_HighWater / 4;
+			m_pBlock = AllocateBlock(m_Capacity);
+		}
+	}
+
+	ArenaStatistics LinearArena::GetStatistics() const
+	{
+		const size_t used{ m_Offset + m_OverflowBytes };
+		return { used, std::max(m_HighWater, used), m_Capacity, m_NumOverflows };
+	}
+
+	FrameArena::FrameArena(size_t capacityPerThread)
+	{
+		const int numThreads{ JobSystem::GetInstance().GetNumThreads() };
+		for (int index{}; index < numThreads; ++index)
+			m_ThreadArenas.push_back(std::make_unique<LinearArena>(capacityPerThread));
+	}
+
+	LinearArena& FrameArena::GetThreadArena()
+	{
+		return *m_ThreadArenas[JobSystem::GetInstance().GetThreadIndex()];
+	}
+
+	void FrameArena::Reset()
+	{
+		for (const std::unique_ptr<LinearArena>& pArena : m_ThreadArenas)
+			pArena->Reset();
+	}
+
+	ArenaStatistics FrameArena::GetStatistics() const
+	{
+		ArenaStatistics statistics{};
+		for (const std::unique_ptr<LinearArena>& pArena : m_ThreadArenas)
+			statistics += pArena->GetStatistics();
+
+		return statistics;
+	}
+}
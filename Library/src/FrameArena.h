@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	struct ArenaStatistics
+	{
+		// Bytes handed out since the last Reset
+		size_t used{};
+		// Most bytes handed out between two Resets
+		size_t highWater{};
+		// Size of the blocks that serve allocations without going to the heap
+		size_t capacity{};
+		// Allocations since the last Reset that did not fit and got their own heap block, should stop once warmed up
+		size_t numOverflows{};
+
+		ArenaStatistics& operator+=(const ArenaStatistics& other)
+		{
+			used += other.used;
+			highWater += other.highWater;
+			capacity += other.capacity;
+			numOverflows += other.numOverflows;
+			return *this;
+		}
+	};
+
+	// Bump allocator for data that lives until the next Reset, individual allocations are never freed
+	// Allocations that don't fit get their own heap block until the next Reset, which grows the arena to the high-water mark
+	// Not thread safe, give every thread its own arena
+	class LinearArena final
+	{
+	public:
+		explicit LinearArena(size_t capacity = 0);
+		~LinearArena();
+
+		LinearArena(const LinearArena&) = delete;
+		LinearArena(LinearArena&&) noexcept = delete;
+		LinearArena& operator=(const LinearArena&) = delete;
+		LinearArena& operator=(LinearArena&&) noexcept = delete;
+
+		void* Allocate(size_t size, size_t alignment);
+		// Invalidates everything allocated so far
+		void Reset();
+
+		ArenaStatistics GetStatistics() const;
+
+	private:
+		std::byte* m_pBlock{};
+		size_t m_Capacity{};
+		size_t m_Offset{};
+
+		std::vector<std::byte*> m_OverflowBlocks{};
+		size_t m_OverflowBytes{};
+		size_t m_NumOverflows{};
+
+		size_t m_HighWater{};
+	};
+
+	// STL allocator on top of a LinearArena, deallocate does nothing
+	// Containers using it have to be destroyed or emptied before the arena is Reset
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+		using value_type = T;
+		// Containers take the arena along when they are assigned, so a freshly made container can replace one of the previous frame
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		ArenaAllocator() noexcept = default;
+		ArenaAllocator(LinearArena& arena) noexcept : m_pArena{ &arena } {}
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_pArena{ other.GetArena() } {}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(m_pArena->Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, size_t) noexcept
+		{
+		}
+
+		LinearArena* GetArena() const { return m_pArena; }
+
+		template<typename U>
+		bool operator==(const ArenaAllocator<U>& other) const { return m_pArena == other.GetArena(); }
+
+	private:
+		LinearArena* m_pArena{};
+	};
+
+	template<typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+	// One LinearArena per JobSystem thread, so jobs allocate without locks
+	// Threads outside the job system share the last arena, only one of them may allocate at a time
+	class FrameArena final
+	{
+	public:
+		explicit FrameArena(size_t capacityPerThread = 0);
+
+		// Arena of the calling thread
+		LinearArena& GetThreadArena();
+		// Not thread safe, call when no jobs allocate from this FrameArena anymore
+		void Reset();
+
+		ArenaStatistics GetStatistics() const;
+
+	private:
+		std::vector<std::unique_ptr<LinearArena>> m_ThreadArenas{};
+	};
+}
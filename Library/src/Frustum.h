@@ -0,0 +1,82 @@
+#pragma once
+#include <cmath>
+
+#include "BoundingBox.h"
+#include "Matrix.h"
+#include "Vector4.h"
+
+namespace dae
+{
+	// The six planes of a view projection matrix (row vectors, depth in [0, 1]), normals pointing inward
+	class Frustum final
+	{
+	public:
+		enum class Containment
+		{
+			Outside,
+			Intersecting,
+			Inside
+		};
+
+		Frustum() = default;
+		explicit Frustum(const Matrix& viewProjectionMatrix)
+		{
+			// Clip space position is p * M, so every plane is a combination of the columns of M (Gribb/Hartmann)
+			const Matrix& m{ viewProjectionMatrix };
+			const auto column = [&m](int index) { return Vector4{ m[0][index], m[1][index], m[2][index], m[3][index] }; };
+			const Vector4 x{ column(0) };
+			const Vector4 y{ column(1) };
+			const Vector4 z{ column(2) };
+			const Vector4 w{ column(3) };
+
+			m_Planes[0] = w + x;
+			m_Planes[1] = w - x;
+			m_Planes[2] = w + y;
+			m_Planes[3] = w - y;
+			m_Planes[4] = z;
+			m_Planes[5] = w - z;
+
+			// Unit normals, so plane distances are real distances for the sphere test
+			for (Vector4& plane : m_Planes)
+				plane = plane * (1.f / std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z));
+		}
+
+		Containment Test(const BoundingBox& box) const
+		{
+			Containment containment{ Containment::Inside };
+			for (const Vector4& plane : m_Planes)
+			{
+				// Corner furthest along the plane normal, then the one furthest against it
+				const Vector3 positive{ plane.x >= 0.f ? box.max.x : box.min.x, plane.y >= 0.f ? box.max.y : box.min.y, plane.z >= 0.f ? box.max.z : box.min.z };
+				const Vector3 negative{ plane.x >= 0.f ? box.min.x : box.max.x, plane.y >= 0.f ? box.min.y : box.max.y, plane.z >= 0.f ? box.min.z : box.max.z };
+
+				if (Distance(plane, positive) < 0.f)
+					return Containment::Outside;
+				if (Distance(plane, negative) < 0.f)
+					containment = Containment::Intersecting;
+			}
+
+			return containment;
+		}
+
+		// Conservative, a sphere only counts as outside when it is completely behind one plane
+		bool IsOutside(const Vector3& center, float radius) const
+		{
+			for (const Vector4& plane : m_Planes)
+			{
+				if (Distance(plane, center) < -radius)
+					return true;
+			}
+
+			return false;
+		}
+
+	private:
+		Vector4 m_Planes[6]{};
+
+		static float Distance(const Vector4& plane, const Vector3& point)
+		{
+			return plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w;
+		}
+	};
+}
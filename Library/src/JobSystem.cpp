@@ -0,0 +1,335 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace dae
+{
+	namespace
+	{
+		// Index of the calling worker's queue, -1 on threads outside the job system
+		thread_local int t_WorkerIndex{ -1 };
+	}
+
+	// Free list of job sized blocks, jobs are created by the hundreds every frame and reuse the memory of finished ones
+	class JobSystem::JobPool final
+	{
+	public:
+		// Room for a Job and the shared_ptr control block around it
+		static constexpr size_t m_BlockSize{ 256 };
+
+		JobPool() = default;
+		~JobPool()
+		{
+			for (void* pBlock : m_FreeBlocks)
+				::operator delete(pBlock);
+		}
+
+		JobPool(const JobPool&) = delete;
+		JobPool(JobPool&&) noexcept = delete;
+		JobPool& operator=(const JobPool&) = delete;
+		JobPool& operator=(JobPool&&) noexcept = delete;
+
+		void* Allocate()
+		{
+			{
+				const std::lock_guard lock{ m_Mutex };
+				if (!m_FreeBlocks.empty())
+				{
+					void* pBlock{ m_FreeBlocks.back() };
+					m_FreeBlocks.pop_back();
+					return pBlock;
+				}
+			}
+
+			return ::operator new(m_BlockSize);
+		}
+
+		void Free(void* pBlock)
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_FreeBlocks.push_back(pBlock);
+		}
+
+		// Allocator for std::allocate_shared, which only ever asks for a single control block
+		template<typename T>
+		class Allocator
+		{
+		public:
+			using value_type = T;
+
+			explicit Allocator(JobPool& pool) noexcept : m_pPool{ &pool } {}
+			template<typename U>
+			Allocator(const Allocator<U>& other) noexcept : m_pPool{ other.GetPool() } {}
+
+			T* allocate(size_t count)
+			{
+				static_assert(sizeof(T) <= m_BlockSize && alignof(T) <= alignof(std::max_align_t), "ERROR: job does not fit a JobPool block!");
+				assert(count == 1);
+				(void)count;
+				return static_cast<T*>(m_pPool->Allocate());
+			}
+
+			void deallocate(T* pBlock, size_t) noexcept
+			{
+				m_pPool->Free(pBlock);
+			}
+
+			JobPool* GetPool() const { return m_pPool; }
+
+			template<typename U>
+			bool operator==(const Allocator<U>& other) const { return m_pPool == other.GetPool(); }
+
+		private:
+			JobPool* m_pPool;
+		};
+
+	private:
+		std::mutex m_Mutex{};
+		std::vector<void*> m_FreeBlocks{};
+	};
+
+	Job::Job(std::function<void()> function, JobHandle pParent) :
+		m_Function{ std::move(function) },
+		m_pParent{ std::move(pParent) }
+	{
+	}
+
+	JobSystem& JobSystem::GetInstance()
+	{
+		static JobSystem jobSystem{};
+		return jobSystem;
+	}
+
+	JobSystem::JobSystem() :
+		m_pJobPool{ std::make_unique<JobPool>() }
+	{
+		// The thread that waits helps out, so one worker less than there are cores, but at least one
+		const int numWorkers{ std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1) };
+
+		for (int index{}; index <= numWorkers; ++index)
+			m_Queues.push_back(std::make_unique<WorkQueue>());
+
+		for (int index{}; index < numWorkers; ++index)
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this, index);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			const std::lock_guard lock{ m_WakeMutex };
+			m_IsQuitting = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	JobHandle JobSystem::CreateJob(std::function<void()> function, const JobHandle& pParent)
+	{
+		if (pParent)
+		{
+			assert(!pParent->IsFinished() && "ERROR: parent job already finished!");
+			pParent->m_NumUnfinished.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return std::allocate_shared<Job>(JobPool::Allocator<Job>{ *m_pJobPool }, std::move(function), pParent);
+	}
+
+	void JobSystem::AddDependency(const JobHandle& pJob, const JobHandle& pDependency)
+	{
+		const std::lock_guard lock{ pDependency->m_ContinuationMutex };
+		if (pDependency->m_HasFinished)
+			return;
+
+		pJob->m_NumPendingDependencies.fetch_add(1, std::memory_order_relaxed);
+		pDependency->m_Continuations.push_back(pJob);
+	}
+
+	void JobSystem::Submit(const JobHandle& pJob)
+	{
+		if (pJob->m_NumPendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Enqueue(pJob);
+	}
+
+	void JobSystem::Wait(const JobHandle& pJob)
+	{
+		while (!pJob->IsFinished())
+		{
+			if (const JobHandle pOther{ TryGetJob() })
+				Execute(pOther);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	int JobSystem::GetThreadIndex() const
+	{
+		return t_WorkerIndex >= 0 ? t_WorkerIndex : static_cast<int>(m_Workers.size());
+	}
+
+	void JobSystem::RunParallelFor(int begin, int end, const RangeFunction& body, int minGrain)
+	{
+		if (begin >= end)
+			return;
+
+		// A few ranges per thread, so threads that finish early can steal the rest
+		const int grain{ std::max({ 1, minGrain, (end - begin) / (GetNumThreads() * 4) }) };
+		if (end - begin <= grain)
+		{
+			body(begin, end);
+			return;
+		}
+
+		const ParallelForState state{ CreateJob([] {}), body, grain };
+		SplitRange(&state, begin, end);
+		Submit(state.pRoot);
+		Wait(state.pRoot);
+	}
+
+	void JobSystem::SplitRange(const ParallelForState* pState, int begin, int end)
+	{
+		// Hands off the upper halves and keeps the lowest part, thieves take the biggest halves first
+		// Small enough a capture for std::function to store it without allocating
+		Submit(CreateJob([pState, begin, end]()
+			{
+				int last{ end };
+				while (last - begin > pState->grain)
+				{
+					const int middle{ begin + (last - begin) / 2 };
+					GetInstance().SplitRange(pState, middle, last);
+					last = middle;
+				}
+
+				pState->body(begin, last);
+			}, pState->pRoot));
+	}
+
+	void JobSystem::WorkerLoop(int workerIndex)
+	{
+		t_WorkerIndex = workerIndex;
+
+		for (;;)
+		{
+			if (const JobHandle pJob{ TryGetJob() })
+			{
+				Execute(pJob);
+				continue;
+			}
+
+			std::unique_lock lock{ m_WakeMutex };
+			m_WakeCondition.wait(lock, [this]() { return m_IsQuitting || m_NumQueuedJobs.load(std::memory_order_acquire) > 0; });
+			if (m_IsQuitting)
+				return;
+		}
+	}
+
+	void JobSystem::Enqueue(JobHandle pJob)
+	{
+		WorkQueue& queue{ *m_Queues[t_WorkerIndex >= 0 ? t_WorkerIndex : m_Queues.size() - 1] };
+		{
+			const std::lock_guard lock{ queue.mutex };
+			queue.PushBack(std::move(pJob));
+		}
+		m_NumQueuedJobs.fetch_add(1, std::memory_order_release);
+
+		// Taking the mutex makes sure a worker checking its wait predicate can't miss the notify
+		{
+			const std::lock_guard lock{ m_WakeMutex };
+		}
+		m_WakeCondition.notify_one();
+	}
+
+	JobHandle JobSystem::TryGetJob()
+	{
+		const int numQueues{ static_cast<int>(m_Queues.size()) };
+		const int ownIndex{ t_WorkerIndex >= 0 ? t_WorkerIndex : numQueues - 1 };
+
+		// Newest job of the own queue first, its data is most likely still in cache
+		{
+			WorkQueue& queue{ *m_Queues[ownIndex] };
+			const std::lock_guard lock{ queue.mutex };
+			if (queue.count > 0)
+			{
+				m_NumQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return queue.PopBack();
+			}
+		}
+
+		// Steal the oldest job of another queue
+		for (int offset{ 1 }; offset < numQueues; ++offset)
+		{
+			WorkQueue& queue{ *m_Queues[(ownIndex + offset) % numQueues] };
+			const std::lock_guard lock{ queue.mutex };
+			if (queue.count > 0)
+			{
+				m_NumQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+				return queue.PopFront();
+			}
+		}
+
+		return nullptr;
+	}
+
+	void JobSystem::Execute(const JobHandle& pJob)
+	{
+		pJob->m_Function();
+		// Releases whatever the function captured before the job itself goes away
+		pJob->m_Function = nullptr;
+
+		Finish(pJob);
+	}
+
+	void JobSystem::Finish(const JobHandle& pJob)
+	{
+		// Children still running, the last one to finish finishes this job
+		if (pJob->m_NumUnfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		std::vector<JobHandle> continuations{};
+		{
+			const std::lock_guard lock{ pJob->m_ContinuationMutex };
+			pJob->m_HasFinished = true;
+			continuations.swap(pJob->m_Continuations);
+		}
+
+		for (const JobHandle& pContinuation : continuations)
+			Submit(pContinuation);
+
+		if (pJob->m_pParent)
+			Finish(pJob->m_pParent);
+	}
+
+	void JobSystem::WorkQueue::PushBack(JobHandle pJob)
+	{
+		if (count == jobs.size())
+		{
+			// Full, unwrap into a buffer twice the size
+			std::vector<JobHandle> grown(std::max(size_t{ 64 }, jobs.size() * 2));
+			for (size_t index{}; index < count; ++index)
+				grown[index] = std::move(jobs[(first + index) % jobs.size()]);
+
+			jobs.swap(grown);
+			first = 0;
+		}
+
+		jobs[(first + count) % jobs.size()] = std::move(pJob);
+		++count;
+	}
+
+	JobHandle JobSystem::WorkQueue::PopBack()
+	{
+		--count;
+		return std::move(jobs[(first + count) % jobs.size()]);
+	}
+
+	JobHandle JobSystem::WorkQueue::PopFront()
+	{
+		JobHandle pJob{ std::move(jobs[first]) };
+		first = (first + 1) % jobs.size();
+		--count;
+		return pJob;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class Job;
+	using JobHandle = std::shared_ptr<Job>;
+
+	// Unit of work for the JobSystem, only created through JobSystem::CreateJob
+	class Job final
+	{
+	public:
+		explicit Job(std::function<void()> function, JobHandle pParent);
+
+		// Done once its function and the functions of all its children have run
+		bool IsFinished() const { return m_NumUnfinished.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::function<void()> m_Function;
+		JobHandle m_pParent;
+
+		// This job plus its unfinished children
+		std::atomic<int> m_NumUnfinished{ 1 };
+		// Unfinished dependencies plus one until Submit is called
+		std::atomic<int> m_NumPendingDependencies{ 1 };
+
+		std::mutex m_ContinuationMutex{};
+		std::vector<JobHandle> m_Continuations{};
+		bool m_HasFinished{ false };
+	};
+
+	// Task scheduler with one deque per worker thread and work stealing
+	// Owners push and pop at the back of their deque, idle threads steal from the front of the others
+	// Threads outside the system share one extra deque and only run jobs while they Wait
+	class JobSystem final
+	{
+	public:
+		static JobSystem& GetInstance();
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		// A job with a parent keeps the parent from finishing until the job is done too (fork-join)
+		JobHandle CreateJob(std::function<void()> function, const JobHandle& pParent = nullptr);
+		// Job only runs once dependency has finished, call before submitting job
+		void AddDependency(const JobHandle& pJob, const JobHandle& pDependency);
+		// Queues the job as soon as all its dependencies have finished
+		void Submit(const JobHandle& pJob);
+		// Runs other jobs until pJob has finished instead of blocking the thread
+		void Wait(const JobHandle& pJob);
+
+		// Calls body(first, last) for subranges of [begin, end) and returns once all of them are done
+		// Ranges are split in halves down to a grain size that scales with the range and the number of threads, but never below minGrain
+		template<typename Body>
+		void ParallelFor(int begin, int end, const Body& body, int minGrain = 1)
+		{
+			// Referenced instead of copied into a std::function, body outlives the call anyway
+			const RangeFunction function{ &body, [](const void* pBody, int first, int last) { (*static_cast<const Body*>(pBody))(first, last); } };
+			RunParallelFor(begin, end, function, minGrain);
+		}
+
+		// Worker threads plus the thread that waits
+		int GetNumThreads() const { return static_cast<int>(m_Workers.size()) + 1; }
+		// In [0, GetNumThreads()), threads outside the system all get the last index
+		int GetThreadIndex() const;
+
+	private:
+		JobSystem();
+
+		class JobPool;
+
+		// Ring buffer that only grows, so queues don't allocate once they are warmed up
+		struct WorkQueue
+		{
+			std::mutex mutex{};
+			std::vector<JobHandle> jobs{};
+			size_t first{};
+			size_t count{};
+
+			void PushBack(JobHandle pJob);
+			JobHandle PopBack();
+			JobHandle PopFront();
+		};
+
+		struct RangeFunction
+		{
+			const void* pBody{};
+			void (*pInvoke)(const void*, int, int){};
+
+			void operator()(int first, int last) const { pInvoke(pBody, first, last); }
+		};
+
+		// Lives on the stack of the thread in ParallelFor, split jobs only capture a pointer to it
+		struct ParallelForState
+		{
+			JobHandle pRoot{};
+			RangeFunction body{};
+			int grain{};
+		};
+
+		void WorkerLoop(int workerIndex);
+		void Enqueue(JobHandle pJob);
+		JobHandle TryGetJob();
+		void Execute(const JobHandle& pJob);
+		void Finish(const JobHandle& pJob);
+		void RunParallelFor(int begin, int end, const RangeFunction& body, int minGrain);
+		void SplitRange(const ParallelForState* pState, int begin, int end);
+
+		// Declared first, jobs still referenced by the other members give their memory back to it
+		std::unique_ptr<JobPool> m_pJobPool;
+
+		// One per worker, the last one is shared by every thread outside the system
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues{};
+		std::vector<std::thread> m_Workers{};
+
+		std::atomic<int> m_NumQueuedJobs{};
+		std::mutex m_WakeMutex{};
+		std::condition_variable m_WakeCondition{};
+		bool m_IsQuitting{ false };
+	};
+}
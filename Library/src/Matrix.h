@@ -1,4 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <span>
+#include <type_traits>
+#include <xmmintrin.h>
+
+#include "MathHelpers.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
@@ -6,58 +14,438 @@ namespace dae {
 	struct Matrix
 	{
 		Matrix() = default;
-		Matrix(
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-
-		Vector4 TransformPoint(const Vector4& p) const;
-		Vector4 TransformPoint(float x, float y, float z, float w) const;
-
-		const Matrix& Transpose();
-		const Matrix& Inverse();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-		static Matrix Inverse(const Matrix& m);
-
-		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up, const Vector3& right);
-		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
-		bool operator==(const Matrix& m) const;
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		constexpr Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v.x, v.y, v.z);
+		}
+
+		constexpr Vector3 TransformVector(float x, float y, float z) const
+		{
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+		}
+
+		constexpr Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z);
+		}
+
+		constexpr Vector3 TransformPoint(float x, float y, float z) const
+		{
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+		}
+
+		constexpr Vector4 TransformPoint(const Vector4& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z, p.w);
+		}
+
+		// w is not used, the translation row is always added
+		constexpr Vector4 TransformPoint(float x, float y, float z, float w) const
+		{
+			if (!std::is_constant_evaluated())
+			{
+				Vector4 result;
+				_mm_store_ps(&result.x, TransformPointSimd(_mm_setr_ps(x, y, z, w)));
+				return result;
+			}
+
+			return Vector4{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+				data[0].w * x + data[1].w * y + data[2].w * z + data[3].w
+			};
+		}
+
+		// Batched TransformPoint(Vector4) with the rows kept in registers, points and transformed need the same size
+		void TransformPoints(std::span<const Vector4> points, std::span<Vector4> transformed) const
+		{
+			assert(points.size() == transformed.size());
+
+			const __m128 row0{ _mm_load_ps(&data[0].x) };
+			const __m128 row1{ _mm_load_ps(&data[1].x) };
+			const __m128 row2{ _mm_load_ps(&data[2].x) };
+			const __m128 row3{ _mm_load_ps(&data[3].x) };
+
+			for (size_t i{}; i < points.size(); ++i)
+			{
+				const __m128 point{ _mm_load_ps(&points[i].x) };
+				_mm_store_ps(&transformed[i].x, TransformPointSimd(point, row0, row1, row2, row3));
+			}
+		}
+
+		constexpr const Matrix& Transpose()
+		{
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = data[c][r];
+				}
+			}
+
+			data[0] = result[0];
+			data[1] = result[1];
+			data[2] = result[2];
+			data[3] = result[3];
+
+			return *this;
+		}
+
+		const Matrix& Inverse()
+		{
+			//Optimized Inverse as explained in FGED1 - used widely in other libraries too.
+			//Only the xyz lanes of a, b, c and d take part, their w lanes are read into x, y, z and w
+			const __m128 a{ _mm_load_ps(&data[0].x) };
+			const __m128 b{ _mm_load_ps(&data[1].x) };
+			const __m128 c{ _mm_load_ps(&data[2].x) };
+			const __m128 d{ _mm_load_ps(&data[3].x) };
+
+			const __m128 x{ _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)) };
+			const __m128 y{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3)) };
+			const __m128 z{ _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3)) };
+			const __m128 w{ _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3)) };
+
+			__m128 s{ Cross3Simd(a, b) };
+			__m128 t{ Cross3Simd(c, d) };
+			__m128 u{ _mm_sub_ps(_mm_mul_ps(a, y), _mm_mul_ps(b, x)) };
+			__m128 v{ _mm_sub_ps(_mm_mul_ps(c, w), _mm_mul_ps(d, z)) };
+
+			const __m128 det{ _mm_add_ss(Dot3Simd(s, v), Dot3Simd(t, u)) };
+			assert((!AreEqual(_mm_cvtss_f32(det), 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+			const __m128 invDet{ _mm_div_ps(_mm_set1_ps(1.f), _mm_shuffle_ps(det, det, _MM_SHUFFLE(0, 0, 0, 0))) };
+
+			s = _mm_mul_ps(s, invDet); t = _mm_mul_ps(t, invDet); u = _mm_mul_ps(u, invDet); v = _mm_mul_ps(v, invDet);
+
+			__m128 r0{ _mm_add_ps(Cross3Simd(b, v), _mm_mul_ps(t, y)) };
+			__m128 r1{ _mm_sub_ps(Cross3Simd(v, a), _mm_mul_ps(t, x)) };
+			__m128 r2{ _mm_add_ps(Cross3Simd(d, u), _mm_mul_ps(s, w)) };
+			__m128 r3{ _mm_sub_ps(Cross3Simd(u, c), _mm_mul_ps(s, z)) };
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			_mm_store_ps(&data[0].x, r0);
+			_mm_store_ps(&data[1].x, r1);
+			_mm_store_ps(&data[2].x, r2);
+			data[3] = {
+				-_mm_cvtss_f32(Dot3Simd(b, t)),
+				_mm_cvtss_f32(Dot3Simd(a, t)),
+				-_mm_cvtss_f32(Dot3Simd(d, s)),
+				_mm_cvtss_f32(Dot3Simd(c, s))
+			};
+
+			return *this;
+		}
+
+		// Cheaper Inverse for matrices whose last column is (0, 0, 0, 1), like world and view matrices
+		const Matrix& InverseAffine()
+		{
+			const __m128 a{ _mm_load_ps(&data[0].x) };
+			const __m128 b{ _mm_load_ps(&data[1].x) };
+			const __m128 c{ _mm_load_ps(&data[2].x) };
+			const __m128 t{ _mm_load_ps(&data[3].x) };
+
+			// Columns of the inverse 3x3 are the cross products of the other two rows over the determinant
+			__m128 r0{ Cross3Simd(b, c) };
+			__m128 r1{ Cross3Simd(c, a) };
+			__m128 r2{ Cross3Simd(a, b) };
+
+			const __m128 det{ Dot3Simd(a, r0) };
+			assert((!AreEqual(_mm_cvtss_f32(det), 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+			const __m128 invDet{ _mm_div_ps(_mm_set1_ps(1.f), _mm_shuffle_ps(det, det, _MM_SHUFFLE(0, 0, 0, 0))) };
+
+			r0 = _mm_mul_ps(r0, invDet);
+			r1 = _mm_mul_ps(r1, invDet);
+			r2 = _mm_mul_ps(r2, invDet);
+			__m128 r3{ _mm_setzero_ps() };
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			// -t * inverse(3x3), with w set to 1
+			const __m128 translation{ _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)), r0),
+				_mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), r1)),
+				_mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), r2)) };
+
+			_mm_store_ps(&data[0].x, r0);
+			_mm_store_ps(&data[1].x, r1);
+			_mm_store_ps(&data[2].x, r2);
+			_mm_store_ps(&data[3].x, _mm_sub_ps(_mm_setr_ps(0.f, 0.f, 0.f, 1.f), translation));
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const
+		{
+			return data[0];
+		}
+
+		constexpr Vector3 GetAxisY() const
+		{
+			return data[1];
+		}
+
+		constexpr Vector3 GetAxisZ() const
+		{
+			return data[2];
+		}
+
+		constexpr Vector3 GetTranslation() const
+		{
+			return data[3];
+		}
+
+		// Length of the longest axis, the most this matrix stretches any direction without shear
+		float GetMaxAxisScale() const
+		{
+			return std::max(GetAxisX().Magnitude(), std::max(GetAxisY().Magnitude(), GetAxisZ().Magnitude()));
+		}
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			return CreateTranslation({ x, y, z });
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			return {
+				{1, 0, 0, 0},
+				{0, cos(pitch), -sin(pitch), 0},
+				{0, sin(pitch), cos(pitch), 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			return {
+				{cos(yaw), 0, -sin(yaw), 0},
+				{0, 1, 0, 0},
+				{sin(yaw), 0, cos(yaw), 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			return {
+				{cos(roll), sin(roll), 0, 0},
+				{-sin(roll), cos(roll), 0, 0},
+				{0, 0, 1, 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			return CreateRotationX(r[0]) * CreateRotationY(r[1]) * CreateRotationZ(r[2]);
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			return { Vector3{ sx, 0, 0 }, Vector3{ 0, sy, 0 }, Vector3{ 0, 0, sz }, Vector3::Zero };
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static constexpr Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+		static Matrix InverseAffine(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.InverseAffine();
+
+			return out;
+		}
+
+		static constexpr Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up, const Vector3& right)
+		{
+			//TODO W1
+		/*	const Vector3 zAxis{ (forward - origin).Normalized() };
+			const Vector3 xAxis{ (Vector3::Cross(up, zAxis)).Normalized() };
+			const Vector3 yAxis{ (Vector3::Cross(zAxis, xAxis)).Normalized() };*/
+
+			const Vector4 translationOffset{
+				-Vector3::Dot(right, origin),
+				-Vector3::Dot(up, origin),
+				-Vector3::Dot(forward, origin),
+				1
+			};
+
+			return Matrix{
+				Vector4{right.x, up.x, forward.x, 0 },
+				Vector4{right.y, up.y, forward.y, 0 },
+				Vector4{right.z, up.z, forward.z, 0 },
+				translationOffset
+			};
+		}
+
+		static constexpr Matrix CreatePerspectiveFovLH(float fov, float aspect, float zn, float zf)
+		{
+			//TODO W3
+			const Vector4 xAxis{ 1 / (aspect * fov), 0, 0, 0 };
+			const Vector4 yAxis{ 0,	1 / fov, 0, 0 };
+			const Vector4 zAxis{ 0, 0, zf / (zf - zn), 1 };
+			const Vector4 t{ 0, 0, -(zf * zn) / (zf - zn), 0 };
+
+			return {
+				xAxis,
+				yAxis,
+				zAxis,
+				t
+			};
+		}
+
+#pragma region Operator Overloads
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		// Same summation order as a dot product of row r with column c
+		constexpr Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{};
+			if (!std::is_constant_evaluated())
+			{
+				// Row r of the result is the rows of m weighted by the elements of row r
+				const __m128 row0{ _mm_load_ps(&m.data[0].x) };
+				const __m128 row1{ _mm_load_ps(&m.data[1].x) };
+				const __m128 row2{ _mm_load_ps(&m.data[2].x) };
+				const __m128 row3{ _mm_load_ps(&m.data[3].x) };
+
+				for (int r{ 0 }; r < 4; ++r)
+				{
+					const __m128 row{ _mm_load_ps(&data[r].x) };
+					const __m128 sum{ _mm_add_ps(_mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), row0),
+						_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), row1)),
+						_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), row2)),
+						_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), row3)) };
+					_mm_store_ps(&result.data[r].x, sum);
+				}
+
+				return result;
+			}
+
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result.data[r][c] = data[r].x * m.data[0][c] + data[r].y * m.data[1][c] + data[r].z * m.data[2][c] + data[r].w * m.data[3][c];
+				}
+			}
+
+			return result;
+		}
+
+		constexpr const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
+
+		bool operator==(const Matrix& m) const
+		{
+			return data[0] == m.data[0]
+				&& data[1] == m.data[1]
+				&& data[2] == m.data[2]
+				&& data[3] == m.data[3];
+		}
+#pragma endregion
 
 	private:
+		__m128 TransformPointSimd(__m128 point) const
+		{
+			return TransformPointSimd(point, _mm_load_ps(&data[0].x), _mm_load_ps(&data[1].x), _mm_load_ps(&data[2].x), _mm_load_ps(&data[3].x));
+		}
+
+		// Same summation order as the scalar TransformPoint
+		static __m128 TransformPointSimd(__m128 point, __m128 row0, __m128 row1, __m128 row2, __m128 row3)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_shuffle_ps(point, point, _MM_SHUFFLE(0, 0, 0, 0)), row0),
+				_mm_mul_ps(_mm_shuffle_ps(point, point, _MM_SHUFFLE(1, 1, 1, 1)), row1)),
+				_mm_mul_ps(_mm_shuffle_ps(point, point, _MM_SHUFFLE(2, 2, 2, 2)), row2)),
+				row3);
+		}
+
+		// Vector3::Cross on the xyz lanes, w ends up 0
+		static __m128 Cross3Simd(__m128 v1, __m128 v2)
+		{
+			const __m128 v1yzx{ _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(3, 0, 2, 1)) };
+			const __m128 v1zxy{ _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(3, 1, 0, 2)) };
+			const __m128 v2yzx{ _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 0, 2, 1)) };
+			const __m128 v2zxy{ _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 1, 0, 2)) };
+			return _mm_sub_ps(_mm_mul_ps(v1yzx, v2zxy), _mm_mul_ps(v1zxy, v2yzx));
+		}
+
+		// Vector3::Dot on the xyz lanes in the lowest lane, same summation order
+		static __m128 Dot3Simd(__m128 v1, __m128 v2)
+		{
+			const __m128 products{ _mm_mul_ps(v1, v2) };
+			const __m128 xy{ _mm_add_ss(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(1, 1, 1, 1))) };
+			return _mm_add_ss(xy, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 2, 2, 2)));
+		}
 
 		//Row-Major Matrix
 		Vector4 data[4]
@@ -73,4 +461,4 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+}
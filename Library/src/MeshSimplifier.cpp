@@ -0,0 +1,501 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "JobSystem.h"
+#include "MeshletBuilder.h"
+
+namespace dae
+{
+	namespace MeshSimplifier
+	{
+		namespace
+		{
+			// Open edges get a plane through them, perpendicular to their triangle and this much heavier, so borders don't shrink inward
+			constexpr double borderWeight{ 10.0 };
+			// A collapse that merges two sides of a uv or normal seam counts as this fraction of the mesh radius of error
+			constexpr float seamError{ .05f };
+			// Collapses that turn a remaining triangle further than about 75 degrees are skipped
+			constexpr float minNormalDot{ .25f };
+			// A level that keeps more than this fraction of the triangles of the level before is not worth it
+			constexpr float minReduction{ .8f };
+
+			// Sum of squared plane distances, weighted by triangle area, as the symmetric 4x4 matrix of Garland and Heckbert
+			struct Quadric
+			{
+				double a2{}, ab{}, ac{}, ad{};
+				double b2{}, bc{}, bd{};
+				double c2{}, cd{};
+				double d2{};
+				double weight{};
+
+				void AddPlane(const Vector3& normal, float distance, double planeWeight)
+				{
+					const double a{ normal.x }, b{ normal.y }, c{ normal.z }, d{ distance };
+					a2 += planeWeight * a * a; ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+					b2 += planeWeight * b * b; bc += planeWeight * b * c; bd += planeWeight * b * d;
+					c2 += planeWeight * c * c; cd += planeWeight * c * d;
+					d2 += planeWeight * d * d;
+					weight += planeWeight;
+				}
+
+				Quadric& operator+=(const Quadric& other)
+				{
+					a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+					b2 += other.b2; bc += other.bc; bd += other.bd;
+					c2 += other.c2; cd += other.cd;
+					d2 += other.d2;
+					weight += other.weight;
+					return *this;
+				}
+
+				double Evaluate(const Vector3& point) const
+				{
+					const double x{ point.x }, y{ point.y }, z{ point.z };
+					const double result{ a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+						+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+						+ c2 * z * z + 2.0 * cd * z
+						+ d2 };
+					return std::max(result, 0.0);
+				}
+			};
+
+			struct Collapse
+			{
+				double cost{};
+				uint32_t from{};
+				uint32_t to{};
+				uint32_t fromVersion{};
+				uint32_t toVersion{};
+
+				bool operator>(const Collapse& other) const { return cost > other.cost; }
+			};
+
+			// Vertices with the same position, normal and uv get the index of the first of them, the OBJ loader gives every corner its own vertex
+			// Tangents are left out, they are accumulated per corner and never match
+			std::vector<uint32_t> WeldAttributes(const std::vector<Vertex>& vertices)
+			{
+				struct Key
+				{
+					float values[8];
+				};
+				struct KeyHash
+				{
+					size_t operator()(const Key& key) const
+					{
+						uint32_t bits[8];
+						std::memcpy(bits, key.values, sizeof(bits));
+						size_t hash{ 2166136261u };
+						for (const uint32_t value : bits)
+							hash = (hash ^ value) * 16777619u;
+						return hash;
+					}
+				};
+				struct KeyEqual
+				{
+					bool operator()(const Key& left, const Key& right) const
+					{
+						return std::equal(std::begin(left.values), std::end(left.values), std::begin(right.values));
+					}
+				};
+
+				std::unordered_map<Key, uint32_t, KeyHash, KeyEqual> ids{};
+				ids.reserve(vertices.size());
+
+				std::vector<uint32_t> welded(vertices.size());
+				for (size_t index{}; index < vertices.size(); ++index)
+				{
+					const Vertex& vertex{ vertices[index] };
+					const Key key{ { vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.uv.x, vertex.uv.y } };
+					welded[index] = ids.emplace(key, static_cast<uint32_t>(index)).first->second;
+				}
+				return welded;
+			}
+
+			std::vector<uint32_t> WeldPositions(const std::vector<Vertex>& vertices, std::vector<Vector3>& positions)
+			{
+				struct PositionHash
+				{
+					size_t operator()(const Vector3& position) const
+					{
+						uint32_t bits[3];
+						std::memcpy(bits, &position.x, sizeof(bits));
+						return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+					}
+				};
+				struct PositionEqual
+				{
+					bool operator()(const Vector3& left, const Vector3& right) const
+					{
+						return left.x == right.x && left.y == right.y && left.z == right.z;
+					}
+				};
+
+				std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> ids{};
+				ids.reserve(vertices.size());
+				positions.clear();
+
+				std::vector<uint32_t> weldedIds(vertices.size());
+				for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+				{
+					const Vector3 position{ vertices[vertex].position };
+					const auto [it, isNew] { ids.emplace(position, static_cast<uint32_t>(positions.size())) };
+					if (isNew)
+						positions.push_back(position);
+					weldedIds[vertex] = it->second;
+				}
+				return weldedIds;
+			}
+
+			float GetAttributeDistance(const Vertex& left, const Vertex& right)
+			{
+				return (left.uv - right.uv).SqrMagnitude() + (left.normal - right.normal).SqrMagnitude();
+			}
+		}
+
+		std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, size_t targetTriangles,
+			float maxError, float& error)
+		{
+			error = 0.f;
+
+			const std::vector<uint32_t> attributeIds{ WeldAttributes(vertices) };
+			std::vector<Vector3> positions{};
+			const std::vector<uint32_t> positionIds{ WeldPositions(vertices, positions) };
+			const size_t numPositions{ positions.size() };
+
+			// Vertex of every corner, degenerate triangles are dropped right away
+			std::vector<uint32_t> corners{};
+			corners.reserve(triangles.size());
+			for (size_t triangle{}; triangle + 2 < triangles.size(); triangle += 3)
+			{
+				const uint32_t v0{ attributeIds[triangles[triangle]] };
+				const uint32_t v1{ attributeIds[triangles[triangle + 1]] };
+				const uint32_t v2{ attributeIds[triangles[triangle + 2]] };
+				if (positionIds[v0] == positionIds[v1] || positionIds[v0] == positionIds[v2] || positionIds[v1] == positionIds[v2])
+					continue;
+				corners.insert(corners.end(), { v0, v1, v2 });
+			}
+
+			size_t numTriangles{ corners.size() / 3 };
+			if (numTriangles <= targetTriangles)
+				return corners;
+
+			const auto getPosition = [&](size_t corner) { return positionIds[corners[corner]]; };
+
+			// Triangles around every position, including ones that were collapsed since, which are skipped
+			std::vector<std::vector<uint32_t>> trianglesAround(numPositions);
+			for (size_t corner{}; corner < corners.size(); ++corner)
+				trianglesAround[getPosition(corner)].push_back(static_cast<uint32_t>(corner / 3));
+
+			std::vector<uint8_t> isTriangleRemoved(numTriangles);
+			std::vector<uint8_t> isPositionRemoved(numPositions);
+			std::vector<uint32_t> versions(numPositions);
+
+			// Face planes, plus border planes for edges that only one triangle uses
+			std::vector<Quadric> quadrics(numPositions);
+			std::unordered_map<uint64_t, int> edgeUses{};
+			edgeUses.reserve(corners.size());
+			const auto getEdgeKey = [](uint32_t left, uint32_t right) { return (static_cast<uint64_t>(std::min(left, right)) << 32) | std::max(left, right); };
+
+			float meshRadius{};
+			{
+				BoundingBox box{};
+				for (const Vector3& position : positions)
+					box.Grow(position);
+				meshRadius = box.IsEmpty() ? 0.f : box.GetExtents().Magnitude();
+			}
+
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+			{
+				const Vector3& p0{ positions[getPosition(triangle * 3)] };
+				const Vector3& p1{ positions[getPosition(triangle * 3 + 1)] };
+				const Vector3& p2{ positions[getPosition(triangle * 3 + 2)] };
+
+				Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+				const float area{ normal.Normalize() * .5f };
+				for (int corner{}; corner < 3; ++corner)
+				{
+					quadrics[getPosition(triangle * 3 + corner)].AddPlane(normal, -Vector3::Dot(normal, p0), area);
+					++edgeUses[getEdgeKey(getPosition(triangle * 3 + corner), getPosition(triangle * 3 + (corner + 1) % 3))];
+				}
+			}
+
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+			{
+				const Vector3& p0{ positions[getPosition(triangle * 3)] };
+				const Vector3& p1{ positions[getPosition(triangle * 3 + 1)] };
+				const Vector3& p2{ positions[getPosition(triangle * 3 + 2)] };
+				const Vector3 faceNormal{ Vector3::Cross(p1 - p0, p2 - p0) };
+
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t start{ getPosition(triangle * 3 + corner) };
+					const uint32_t end{ getPosition(triangle * 3 + (corner + 1) % 3) };
+					if (edgeUses[getEdgeKey(start, end)] != 1)
+						continue;
+
+					const Vector3 edge{ positions[end] - positions[start] };
+					Vector3 normal{ Vector3::Cross(edge, faceNormal) };
+					if (normal.Normalize() == 0.f)
+						continue;
+
+					const double planeWeight{ borderWeight * edge.SqrMagnitude() };
+					const float distance{ -Vector3::Dot(normal, positions[start]) };
+					quadrics[start].AddPlane(normal, distance, planeWeight);
+					quadrics[end].AddPlane(normal, distance, planeWeight);
+				}
+			}
+			edgeUses.clear();
+
+			// Scratch for one collapse, the corners that move and the vertex at the target position each of their vertices becomes
+			struct Remap
+			{
+				uint32_t from{};
+				uint32_t to{};
+			};
+			std::vector<Remap> remaps{};
+			std::vector<uint32_t> targetVertices{};
+			std::vector<uint32_t> fromNeighbors{};
+			std::vector<uint32_t> toNeighbors{};
+
+			const auto isLive = [&](uint32_t triangle, uint32_t position)
+				{
+					if (isTriangleRemoved[triangle])
+						return false;
+					return getPosition(triangle * 3) == position || getPosition(triangle * 3 + 1) == position || getPosition(triangle * 3 + 2) == position;
+				};
+
+			const auto gatherNeighbors = [&](uint32_t position, std::vector<uint32_t>& neighbors)
+				{
+					neighbors.clear();
+					for (const uint32_t triangle : trianglesAround[position])
+					{
+						if (!isLive(triangle, position))
+							continue;
+						for (int corner{}; corner < 3; ++corner)
+						{
+							const uint32_t neighbor{ getPosition(triangle * 3 + corner) };
+							if (neighbor != position && std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end())
+								neighbors.push_back(neighbor);
+						}
+					}
+				};
+
+			// Cost of moving from onto to, negative when the collapse would fold the mesh or change its topology
+			// Fills remaps with the vertex every vertex at from becomes
+			const auto evaluate = [&](uint32_t from, uint32_t to) -> double
+				{
+					// Link condition, the two may only share the neighbors of the triangles on their edge, or the mesh pinches
+					int numShared{};
+					for (const uint32_t triangle : trianglesAround[from])
+					{
+						if (isLive(triangle, from) && isLive(triangle, to))
+							++numShared;
+					}
+					if (numShared == 0 || numShared > 2)
+						return -1.0;
+
+					gatherNeighbors(from, fromNeighbors);
+					gatherNeighbors(to, toNeighbors);
+					int numCommon{};
+					for (const uint32_t neighbor : fromNeighbors)
+						numCommon += static_cast<int>(std::find(toNeighbors.begin(), toNeighbors.end(), neighbor) != toNeighbors.end());
+					if (numCommon != numShared)
+						return -1.0;
+
+					targetVertices.clear();
+					for (const uint32_t triangle : trianglesAround[to])
+					{
+						if (!isLive(triangle, to))
+							continue;
+						for (int corner{}; corner < 3; ++corner)
+						{
+							const uint32_t vertex{ corners[triangle * 3 + corner] };
+							if (positionIds[vertex] == to && std::find(targetVertices.begin(), targetVertices.end(), vertex) == targetVertices.end())
+								targetVertices.push_back(vertex);
+						}
+					}
+
+					remaps.clear();
+					bool isSeamTorn{ false };
+					for (const uint32_t triangle : trianglesAround[from])
+					{
+						if (!isLive(triangle, from) || isLive(triangle, to))
+							continue;
+
+						Vector3 oldPositions[3];
+						Vector3 newPositions[3];
+						for (int corner{}; corner < 3; ++corner)
+						{
+							const uint32_t vertex{ corners[triangle * 3 + corner] };
+							oldPositions[corner] = positions[positionIds[vertex]];
+							newPositions[corner] = positionIds[vertex] == from ? positions[to] : oldPositions[corner];
+							if (positionIds[vertex] != from || std::find_if(remaps.begin(), remaps.end(), [vertex](const Remap& remap) { return remap.from == vertex; }) != remaps.end())
+								continue;
+
+							// The vertex at the target that looks the most like this one takes its place
+							uint32_t best{ targetVertices.front() };
+							for (const uint32_t target : targetVertices)
+							{
+								if (GetAttributeDistance(vertices[target], vertices[vertex]) < GetAttributeDistance(vertices[best], vertices[vertex]))
+									best = target;
+							}
+
+							// Two sides of a seam landing on the same vertex close the seam
+							for (const Remap& remap : remaps)
+								isSeamTorn |= remap.to == best;
+							remaps.push_back({ vertex, best });
+						}
+
+						const Vector3 oldNormal{ Vector3::Cross(oldPositions[1] - oldPositions[0], oldPositions[2] - oldPositions[0]) };
+						const Vector3 newNormal{ Vector3::Cross(newPositions[1] - newPositions[0], newPositions[2] - newPositions[0]) };
+						if (Vector3::Dot(oldNormal, newNormal) <= minNormalDot * oldNormal.Magnitude() * newNormal.Magnitude())
+							return -1.0;
+					}
+
+					Quadric quadric{ quadrics[from] };
+					quadric += quadrics[to];
+					double cost{ quadric.Evaluate(positions[to]) };
+					if (isSeamTorn)
+						cost += quadric.weight * static_cast<double>(seamError * meshRadius) * static_cast<double>(seamError * meshRadius);
+					return cost;
+				};
+
+			// Lazy queue, entries of positions that changed since they were pushed are skipped
+			std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue{};
+			const auto pushEdge = [&](uint32_t left, uint32_t right)
+				{
+					const double leftCost{ evaluate(left, right) };
+					const double rightCost{ evaluate(right, left) };
+					if (leftCost < 0.0 && rightCost < 0.0)
+						return;
+
+					const bool isLeftCheaper{ rightCost < 0.0 || (leftCost >= 0.0 && leftCost <= rightCost) };
+					const uint32_t from{ isLeftCheaper ? left : right };
+					const uint32_t to{ isLeftCheaper ? right : left };
+					queue.push({ isLeftCheaper ? leftCost : rightCost, from, to, versions[from], versions[to] });
+				};
+
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+			{
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t start{ getPosition(triangle * 3 + corner) };
+					const uint32_t end{ getPosition(triangle * 3 + (corner + 1) % 3) };
+					// Interior edges show up once in each direction, push them once
+					if (edgeUses.emplace(getEdgeKey(start, end), 0).second)
+						pushEdge(start, end);
+				}
+			}
+			edgeUses.clear();
+
+			const double maxWeightedError{ static_cast<double>(maxError) * static_cast<double>(maxError) };
+			while (numTriangles > targetTriangles && !queue.empty())
+			{
+				const Collapse collapse{ queue.top() };
+				queue.pop();
+
+				if (isPositionRemoved[collapse.from] || isPositionRemoved[collapse.to]
+					|| versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion)
+					continue;
+
+				// Its neighborhood may have changed without either end changing
+				const double cost{ evaluate(collapse.from, collapse.to) };
+				if (cost < 0.0)
+					continue;
+
+				const double weight{ quadrics[collapse.from].weight + quadrics[collapse.to].weight };
+				const double collapseError{ weight > 0.0 ? cost / weight : 0.0 };
+				if (collapseError > maxWeightedError)
+					break;
+
+				if (cost > collapse.cost * 1.0001 + 1e-12)
+				{
+					queue.push({ cost, collapse.from, collapse.to, collapse.fromVersion, collapse.toVersion });
+					continue;
+				}
+
+				error = std::max(error, static_cast<float>(std::sqrt(collapseError)));
+
+				std::vector<uint32_t>& around{ trianglesAround[collapse.to] };
+				for (const uint32_t triangle : trianglesAround[collapse.from])
+				{
+					if (!isLive(triangle, collapse.from))
+						continue;
+
+					if (isLive(triangle, collapse.to))
+					{
+						isTriangleRemoved[triangle] = 1;
+						--numTriangles;
+						continue;
+					}
+
+					for (int corner{}; corner < 3; ++corner)
+					{
+						uint32_t& vertex{ corners[triangle * 3 + corner] };
+						if (positionIds[vertex] == collapse.from)
+							vertex = std::find_if(remaps.begin(), remaps.end(), [vertex](const Remap& remap) { return remap.from == vertex; })->to;
+					}
+					around.push_back(triangle);
+				}
+
+				around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t triangle) { return !isLive(triangle, collapse.to); }), around.end());
+				trianglesAround[collapse.from].clear();
+				trianglesAround[collapse.from].shrink_to_fit();
+
+				quadrics[collapse.to] += quadrics[collapse.from];
+				isPositionRemoved[collapse.from] = 1;
+				++versions[collapse.to];
+
+				gatherNeighbors(collapse.to, toNeighbors);
+				const std::vector<uint32_t> neighbors{ toNeighbors };
+				for (const uint32_t neighbor : neighbors)
+					pushEdge(collapse.to, neighbor);
+			}
+
+			std::vector<uint32_t> result{};
+			result.reserve(numTriangles * 3);
+			for (size_t triangle{}; triangle < isTriangleRemoved.size(); ++triangle)
+			{
+				if (!isTriangleRemoved[triangle])
+					result.insert(result.end(), corners.begin() + triangle * 3, corners.begin() + triangle * 3 + 3);
+			}
+			return result;
+		}
+
+		void BuildLods(Mesh& mesh, int maxLods)
+		{
+			mesh.lods.clear();
+			if (maxLods <= 0)
+				return;
+
+			const std::vector<uint32_t> triangles{ MeshletBuilder::GetTriangleList(mesh) };
+
+			// Every level starts from the full mesh again, so errors don't add up over the levels and they can all run at once
+			std::vector<std::vector<uint32_t>> levels(maxLods);
+			std::vector<float> errors(maxLods);
+			levels[0] = triangles;
+			JobSystem::GetInstance().ParallelFor(1, maxLods, [&](int first, int last)
+				{
+					for (int level{ first }; level < last; ++level)
+						levels[level] = Simplify(mesh.vertices, triangles, (triangles.size() / 3) >> level, std::numeric_limits<float>::max(), errors[level]);
+				});
+
+			for (int level{}; level < maxLods; ++level)
+			{
+				const size_t numTriangles{ levels[level].size() / 3 };
+				if (level > 0 && (numTriangles == 0 || static_cast<float>(numTriangles) > static_cast<float>(mesh.lods.back().numTriangles) * minReduction))
+					break;
+
+				mesh.lods.emplace_back();
+				MeshletBuilder::Build(mesh.vertices, levels[level], mesh.lods.back());
+				mesh.lods.back().error = level > 0 ? std::max(errors[level], mesh.lods[level - 1].error) : 0.f;
+			}
+		}
+	}
+}
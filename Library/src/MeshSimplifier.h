@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace MeshSimplifier
+	{
+		// Collapses edges of a triangle list, cheapest first by quadric error (Garland-Heckbert), until at most targetTriangles are left
+		// Vertices only move onto other vertices, so the result indexes the same vertex array
+		// Collapses that flip a triangle are skipped, ones that tear uv or normal seams cost extra
+		// error is about how far the surface moved, in object space, the root of the largest area weighted quadric error of a collapse
+		// Collapses with more error than maxError are not done
+		std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, size_t targetTriangles,
+			float maxError, float& error);
+
+		// Fills mesh.lods, the full mesh first and then levels of about half the triangles of the one before
+		// Stops at maxLods or once simplifying hardly removes anything more
+		void BuildLods(Mesh& mesh, int maxLods);
+	}
+}
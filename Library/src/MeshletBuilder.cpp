@@ -0,0 +1,317 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace dae
+{
+	namespace MeshletBuilder
+	{
+		namespace
+		{
+			// Candidates score their distance in expected meshlet radii, plus this times how far their normal bends away from the meshlet's
+			constexpr float coneWeight{ .5f };
+			// A meshlet that runs out of connected triangles jumps to an unconnected one at most this many expected radii away
+			constexpr float maxJumpDistance{ .5f };
+
+			Vector3 GetPosition(const std::vector<Vertex>& vertices, const MeshLod& lod, uint32_t meshletVertex)
+			{
+				return Vector3{ vertices[lod.meshletVertices[meshletVertex]].position };
+			}
+
+			void ComputeBounds(const std::vector<Vertex>& vertices, const MeshLod& lod, Meshlet& meshlet)
+			{
+				BoundingBox box{};
+				for (uint32_t vertex{}; vertex < meshlet.numVertices; ++vertex)
+					box.Grow(GetPosition(vertices, lod, meshlet.firstVertex + vertex));
+
+				meshlet.center = box.GetCenter();
+				meshlet.radius = 0.f;
+				for (uint32_t vertex{}; vertex < meshlet.numVertices; ++vertex)
+					meshlet.radius = std::max(meshlet.radius, (GetPosition(vertices, lod, meshlet.firstVertex + vertex) - meshlet.center).Magnitude());
+
+				// Face normals point the way cross(p1 - p0, p2 - p0) does, the front side of a triangle
+				Vector3 normals[maxTriangles];
+				int numNormals{};
+				Vector3 normalSum{};
+				for (uint32_t triangle{}; triangle < meshlet.numTriangles; ++triangle)
+				{
+					const uint8_t* pIndices{ lod.meshletTriangles.data() + (meshlet.firstTriangle + triangle) * 3 };
+					const Vector3 p0{ GetPosition(vertices, lod, meshlet.firstVertex + pIndices[0]) };
+					const Vector3 p1{ GetPosition(vertices, lod, meshlet.firstVertex + pIndices[1]) };
+					const Vector3 p2{ GetPosition(vertices, lod, meshlet.firstVertex + pIndices[2]) };
+
+					const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+					const float length{ normal.Magnitude() };
+					if (length == 0.f)
+						continue;
+
+					normals[numNormals] = normal / length;
+					normalSum += normals[numNormals];
+					++numNormals;
+				}
+
+				meshlet.coneAxis = {};
+				meshlet.coneCutoff = 1.f;
+
+				const float sumLength{ normalSum.Magnitude() };
+				if (numNormals == 0 || sumLength == 0.f)
+					return;
+
+				meshlet.coneAxis = normalSum / sumLength;
+				float minDot{ 1.f };
+				for (int normal{}; normal < numNormals; ++normal)
+					minDot = std::min(minDot, Vector3::Dot(normals[normal], meshlet.coneAxis));
+
+				// Wider than about 84 degrees from the axis, the cone test would hardly ever pass
+				if (minDot <= .1f)
+					return;
+
+				meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+			}
+
+			// Same id for vertices at the same position, so triangles that only share a position (split normals or uvs) are still neighbors
+			std::vector<uint32_t> WeldPositions(const std::vector<Vertex>& vertices)
+			{
+				struct PositionHash
+				{
+					size_t operator()(const Vector3& position) const
+					{
+						uint32_t bits[3];
+						std::memcpy(bits, &position.x, sizeof(bits));
+						return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+					}
+				};
+				struct PositionEqual
+				{
+					bool operator()(const Vector3& left, const Vector3& right) const
+					{
+						return left.x == right.x && left.y == right.y && left.z == right.z;
+					}
+				};
+
+				std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> ids{};
+				ids.reserve(vertices.size());
+
+				std::vector<uint32_t> weldedIds(vertices.size());
+				for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+					weldedIds[vertex] = ids.emplace(Vector3{ vertices[vertex].position }, static_cast<uint32_t>(ids.size())).first->second;
+
+				return weldedIds;
+			}
+		}
+
+		std::vector<uint32_t> GetTriangleList(const Mesh& mesh)
+		{
+			if (mesh.primitiveTopology == PrimitiveTopology::TriangleList)
+				return mesh.indices;
+
+			std::vector<uint32_t> triangles{};
+			for (size_t index{}; index + 2 < mesh.indices.size(); ++index)
+			{
+				const uint32_t index0{ mesh.indices[index] };
+				uint32_t index1{ mesh.indices[index + 1] };
+				uint32_t index2{ mesh.indices[index + 2] };
+
+				if (index % 2 == 1)
+					std::swap(index1, index2);
+
+				// Restarts are encoded as repeated vertices
+				const Vector4& p0{ mesh.vertices[index0].position };
+				const Vector4& p1{ mesh.vertices[index1].position };
+				const Vector4& p2{ mesh.vertices[index2].position };
+				if (p0 == p1 || p0 == p2 || p1 == p2)
+					continue;
+
+				triangles.insert(triangles.end(), { index0, index1, index2 });
+			}
+			return triangles;
+		}
+
+		void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, MeshLod& lod)
+		{
+			lod.meshlets.clear();
+			lod.meshletVertices.clear();
+			lod.meshletTriangles.clear();
+
+			const size_t numTriangles{ triangles.size() / 3 };
+			lod.numTriangles = static_cast<uint32_t>(numTriangles);
+			if (numTriangles == 0)
+				return;
+
+			// Triangles around every welded position, as offsets into one array
+			const std::vector<uint32_t> weldedIds{ WeldPositions(vertices) };
+			const uint32_t numWelded{ *std::max_element(weldedIds.begin(), weldedIds.end()) + 1 };
+			std::vector<uint32_t> adjacencyOffsets(numWelded + 1);
+			for (const uint32_t index : triangles)
+				++adjacencyOffsets[weldedIds[index] + 1];
+			for (uint32_t welded{}; welded < numWelded; ++welded)
+				adjacencyOffsets[welded + 1] += adjacencyOffsets[welded];
+
+			std::vector<uint32_t> adjacency(triangles.size());
+			{
+				std::vector<uint32_t> fill{ adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 };
+				for (size_t corner{}; corner < triangles.size(); ++corner)
+					adjacency[fill[weldedIds[triangles[corner]]]++] = static_cast<uint32_t>(corner / 3);
+			}
+
+			std::vector<Vector3> centroids(numTriangles);
+			std::vector<Vector3> normals(numTriangles);
+			float totalArea{};
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+			{
+				const Vector3 p0{ vertices[triangles[triangle * 3]].position };
+				const Vector3 p1{ vertices[triangles[triangle * 3 + 1]].position };
+				const Vector3 p2{ vertices[triangles[triangle * 3 + 2]].position };
+
+				centroids[triangle] = (p0 + p1 + p2) / 3.f;
+				const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+				const float length{ normal.Magnitude() };
+				normals[triangle] = length > 0.f ? normal / length : Vector3{};
+				totalArea += length * .5f;
+			}
+
+			// Radius of a disc as large as a full meshlet of average triangles, scales the distance term of the score
+			const float expectedRadius{ std::max(std::sqrt(totalArea / static_cast<float>(numTriangles) * static_cast<float>(maxTriangles) / 3.14159265f), 1e-6f) };
+
+			// Meshlet vertex of every mesh vertex in the open meshlet, or -1
+			std::vector<int> localIndices(vertices.size(), -1);
+			std::vector<uint8_t> isUsed(numTriangles);
+			// Index of the meshlet that has the triangle in its candidates
+			std::vector<uint32_t> candidateOf(numTriangles, UINT32_MAX);
+			std::vector<uint32_t> candidates{};
+
+			Meshlet meshlet{};
+			Vector3 centroidSum{};
+			Vector3 normalSum{};
+			size_t nextSeed{};
+
+			const auto countNewVertices = [&](size_t triangle)
+				{
+					const uint32_t* pIndices{ triangles.data() + triangle * 3 };
+					uint32_t numNewVertices{};
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const bool isRepeat{ (corner > 0 && pIndices[corner] == pIndices[0]) || (corner > 1 && pIndices[corner] == pIndices[1]) };
+						if (localIndices[pIndices[corner]] < 0 && !isRepeat)
+							++numNewVertices;
+					}
+					return numNewVertices;
+				};
+
+			const auto closeMeshlet = [&]()
+				{
+					ComputeBounds(vertices, lod, meshlet);
+					for (uint32_t vertex{}; vertex < meshlet.numVertices; ++vertex)
+						localIndices[lod.meshletVertices[meshlet.firstVertex + vertex]] = -1;
+
+					lod.meshlets.push_back(meshlet);
+					meshlet = {};
+					meshlet.firstVertex = static_cast<uint32_t>(lod.meshletVertices.size());
+					meshlet.firstTriangle = static_cast<uint32_t>(lod.meshletTriangles.size() / 3);
+					centroidSum = {};
+					normalSum = {};
+					candidates.clear();
+				};
+
+			const auto addTriangle = [&](size_t triangle)
+				{
+					isUsed[triangle] = 1;
+					for (int corner{}; corner < 3; ++corner)
+					{
+						const uint32_t index{ triangles[triangle * 3 + corner] };
+						if (localIndices[index] < 0)
+						{
+							localIndices[index] = static_cast<int>(meshlet.numVertices++);
+							lod.meshletVertices.push_back(index);
+						}
+						lod.meshletTriangles.push_back(static_cast<uint8_t>(localIndices[index]));
+
+						// Unused triangles touching this corner become candidates for the next pick
+						const uint32_t welded{ weldedIds[index] };
+						for (uint32_t adjacent{ adjacencyOffsets[welded] }; adjacent < adjacencyOffsets[welded + 1]; ++adjacent)
+						{
+							const uint32_t neighbor{ adjacency[adjacent] };
+							if (isUsed[neighbor] || candidateOf[neighbor] == lod.meshlets.size())
+								continue;
+
+							candidateOf[neighbor] = static_cast<uint32_t>(lod.meshlets.size());
+							candidates.push_back(neighbor);
+						}
+					}
+
+					++meshlet.numTriangles;
+					centroidSum += centroids[triangle];
+					normalSum += normals[triangle];
+				};
+
+			// Greedy growth, every meshlet starts at the first unused triangle and takes the neighbor that keeps it the tightest
+			for (size_t numAdded{}; numAdded < numTriangles; ++numAdded)
+			{
+				size_t best{ SIZE_MAX };
+				if (meshlet.numTriangles > 0 && meshlet.numTriangles < maxTriangles)
+				{
+					const Vector3 center{ centroidSum / static_cast<float>(meshlet.numTriangles) };
+					const float normalLength{ normalSum.Magnitude() };
+					const Vector3 axis{ normalLength > 0.f ? normalSum / normalLength : Vector3{} };
+
+					float bestScore{ std::numeric_limits<float>::max() };
+					for (size_t candidate{}; candidate < candidates.size(); )
+					{
+						const uint32_t triangle{ candidates[candidate] };
+						if (isUsed[triangle])
+						{
+							candidates[candidate] = candidates.back();
+							candidates.pop_back();
+							continue;
+						}
+
+						if (meshlet.numVertices + countNewVertices(triangle) <= maxVertices)
+						{
+							const float score{ (centroids[triangle] - center).Magnitude() / expectedRadius + coneWeight * (1.f - Vector3::Dot(normals[triangle], axis)) };
+							if (score < bestScore)
+							{
+								bestScore = score;
+								best = triangle;
+							}
+						}
+						++candidate;
+					}
+				}
+
+				// Nothing connected left, continue on the closest unused triangle so small parts share meshlets
+				if (best == SIZE_MAX && meshlet.numTriangles > 0 && meshlet.numTriangles < maxTriangles && meshlet.numVertices + 3 <= maxVertices)
+				{
+					const Vector3 center{ centroidSum / static_cast<float>(meshlet.numTriangles) };
+					float bestDistance{ maxJumpDistance * expectedRadius };
+					for (size_t triangle{ nextSeed }; triangle < numTriangles; ++triangle)
+					{
+						const float distance{ (centroids[triangle] - center).Magnitude() };
+						if (!isUsed[triangle] && distance < bestDistance)
+						{
+							bestDistance = distance;
+							best = triangle;
+						}
+					}
+				}
+
+				// Full, or nothing close fits anymore
+				if (best == SIZE_MAX)
+				{
+					if (meshlet.numTriangles > 0)
+						closeMeshlet();
+
+					while (isUsed[nextSeed])
+						++nextSeed;
+					best = nextSeed;
+				}
+
+				addTriangle(best);
+			}
+
+			closeMeshlet();
+		}
+	}
+}
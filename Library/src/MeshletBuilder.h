@@ -0,0 +1,19 @@
+#pragma once
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace MeshletBuilder
+	{
+		// Meshlet vertices are indexed with a byte in MeshLod::meshletTriangles
+		constexpr uint32_t maxVertices{ 255 };
+		constexpr uint32_t maxTriangles{ 128 };
+
+		// The triangles of mesh as a list, strips lose their degenerate triangles and get their odd triangles flipped
+		std::vector<uint32_t> GetTriangleList(const Mesh& mesh);
+
+		// Splits a triangle list into the meshlets of lod and computes their culling bounds, replacing any meshlets it had
+		// Meshlets grow over neighboring triangles, so their bounds stay tight, which reorders the triangles
+		void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, MeshLod& lod);
+	}
+}
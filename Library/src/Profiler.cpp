@@ -0,0 +1,119 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace dae
+{
+	namespace
+	{
+		int64_t SteadyClockNs()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// Chrome traces use microseconds, keep the nanoseconds as decimals
+		std::string ToMicroseconds(int64_t ns)
+		{
+			char buffer[32]{};
+			snprintf(buffer, sizeof(buffer), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+			return buffer;
+		}
+	}
+
+	Profiler& Profiler::GetInstance()
+	{
+		static Profiler profiler{};
+		return profiler;
+	}
+
+	Profiler::Profiler() :
+		m_EpochNs{ SteadyClockNs() }
+	{
+	}
+
+	void Profiler::SetSampleInterval(int everyNthFrame)
+	{
+		m_SampleInterval = everyNthFrame;
+		m_IsRecording.store(m_SampleInterval > 0, std::memory_order_relaxed);
+	}
+
+	void Profiler::BeginFrame()
+	{
+		if (m_SampleInterval <= 0)
+			return;
+
+		const bool isRecording{ m_FrameIndex++ % m_SampleInterval == 0 };
+		m_IsRecording.store(isRecording, std::memory_order_relaxed);
+
+		if (isRecording)
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_FrameMarkers.push_back(Now());
+		}
+	}
+
+	void Profiler::Record(const char* name, int64_t startNs, int64_t endNs)
+	{
+		GetThreadEvents().events.push_back({ name, startNs, endNs });
+	}
+
+	int64_t Profiler::Now() const
+	{
+		return SteadyClockNs() - m_EpochNs;
+	}
+
+	Profiler::ThreadEvents& Profiler::GetThreadEvents()
+	{
+		// Every thread appends to its own buffer, the lock is only taken the first time a thread records
+		thread_local ThreadEvents* pThreadEvents{ nullptr };
+		if (!pThreadEvents)
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_ThreadEvents.push_back(std::make_unique<ThreadEvents>());
+			pThreadEvents = m_ThreadEvents.back().get();
+			pThreadEvents->threadId = static_cast<uint32_t>(m_ThreadEvents.size());
+		}
+
+		return *pThreadEvents;
+	}
+
+	bool Profiler::ExportChromeTrace(const std::string& path) const
+	{
+		std::ofstream file{ path };
+		if (!file)
+			return false;
+
+		const std::lock_guard lock{ m_Mutex };
+
+		file << "{\"traceEvents\":[\n";
+
+		bool isFirst{ true };
+		auto separator = [&]() -> const char*
+			{
+				const char* pSeparator{ isFirst ? "" : ",\n" };
+				isFirst = false;
+				return pSeparator;
+			};
+
+		for (size_t i{}; i < m_FrameMarkers.size(); ++i)
+		{
+			file << separator() << "{\"name\":\"Frame " << i << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":"
+				<< ToMicroseconds(m_FrameMarkers[i]) << "}";
+		}
+
+		for (const std::unique_ptr<ThreadEvents>& pThreadEvents : m_ThreadEvents)
+		{
+			for (const Event& event : pThreadEvents->events)
+			{
+				file << separator() << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << pThreadEvents->threadId
+					<< ",\"ts\":" << ToMicroseconds(event.startNs) << ",\"dur\":" << ToMicroseconds(event.endNs - event.startNs) << "}";
+			}
+		}
+
+		file << "\n]}\n";
+
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Compiles every PROFILE_ macro away
+//#define DISABLE_PROFILER
+
+namespace dae
+{
+	// Collects scoped zones per thread and exports them as a Chrome/Perfetto trace (chrome://tracing, ui.perfetto.dev)
+	// Recording is off until SetSampleInterval is called with a non-zero interval
+	class Profiler final
+	{
+	public:
+		static Profiler& GetInstance();
+
+		Profiler(const Profiler&) = delete;
+		Profiler(Profiler&&) noexcept = delete;
+		Profiler& operator=(const Profiler&) = delete;
+		Profiler& operator=(Profiler&&) noexcept = delete;
+
+		// Records every Nth frame, 0 turns recording off
+		void SetSampleInterval(int everyNthFrame);
+		// Frame marker, also decides if the new frame is recorded
+		void BeginFrame();
+
+		bool IsRecording() const { return m_IsRecording.load(std::memory_order_relaxed); }
+		void Record(const char* name, int64_t startNs, int64_t endNs);
+
+		// Not thread safe with Record, call when no zones are open anymore
+		bool ExportChromeTrace(const std::string& path) const;
+
+		// Nanoseconds since the profiler was created
+		int64_t Now() const;
+
+	private:
+		Profiler();
+
+		struct Event
+		{
+			const char* name;
+			int64_t startNs;
+			int64_t endNs;
+		};
+
+		struct ThreadEvents
+		{
+			uint32_t threadId{};
+			std::vector<Event> events{};
+		};
+
+		ThreadEvents& GetThreadEvents();
+
+		int64_t m_EpochNs{};
+
+		std::atomic<bool> m_IsRecording{ false };
+		int m_SampleInterval{};
+		int m_FrameIndex{};
+
+		mutable std::mutex m_Mutex{};
+		std::vector<std::unique_ptr<ThreadEvents>> m_ThreadEvents{};
+		std::vector<int64_t> m_FrameMarkers{};
+	};
+
+	// Records the lifetime of the scope as one zone, name has to outlive the profiler (string literals)
+	class ProfileZone final
+	{
+	public:
+		explicit ProfileZone(const char* name) :
+			m_Name{ name },
+			m_StartNs{ Profiler::GetInstance().IsRecording() ? Profiler::GetInstance().Now() : -1 }
+		{
+		}
+
+		~ProfileZone()
+		{
+			if (m_StartNs >= 0)
+				Profiler::GetInstance().Record(m_Name, m_StartNs, Profiler::GetInstance().Now());
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone(ProfileZone&&) noexcept = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+		ProfileZone& operator=(ProfileZone&&) noexcept = delete;
+
+	private:
+		const char* m_Name;
+		int64_t m_StartNs;
+	};
+}
+
+#ifndef DISABLE_PROFILER
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) const dae::ProfileZone PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_FRAME() dae::Profiler::GetInstance().BeginFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
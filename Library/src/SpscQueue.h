@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+namespace dae
+{
+	// Lock-free single producer, single consumer ring buffer
+	// Capacity has to be a power of 2
+	template<typename T, size_t Capacity>
+	class SpscQueue final
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity has to be a power of 2");
+
+	public:
+		// Producer side, returns false when the queue is full
+		bool TryPush(const T& value)
+		{
+			const size_t tail{ m_Tail.load(std::memory_order_relaxed) };
+			if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+				return false;
+
+			m_Data[tail & (Capacity - 1)] = value;
+			m_Tail.store(tail + 1, std::memory_order_release);
+			m_Tail.notify_one();
+			return true;
+		}
+
+		// Consumer side, returns false when the queue is empty
+		bool TryPop(T& value)
+		{
+			const size_t head{ m_Head.load(std::memory_order_relaxed) };
+			if (head == m_Tail.load(std::memory_order_acquire))
+				return false;
+
+			value = m_Data[head & (Capacity - 1)];
+			m_Head.store(head + 1, std::memory_order_release);
+			m_Head.notify_one();
+			return true;
+		}
+
+		// Consumer side, blocks until there is something to pop
+		T Pop()
+		{
+			T value{};
+			while (!TryPop(value))
+				m_Tail.wait(m_Head.load(std::memory_order_relaxed), std::memory_order_acquire);
+
+			return value;
+		}
+
+	private:
+		T m_Data[Capacity]{};
+
+		// Producer and consumer indices on their own cache lines
+		alignas(64) std::atomic<size_t> m_Head{};
+		alignas(64) std::atomic<size_t> m_Tail{};
+	};
+}
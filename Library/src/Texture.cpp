@@ -1,5 +1,6 @@
 #include "Texture.h"
 #include "Vector2.h"
+#include "Profiler.h"
 #include <SDL_image.h>
 
 #include <iostream>
@@ -23,6 +24,8 @@ namespace dae
 
 	Texture* Texture::LoadFromFile(const std::string& path)
 	{
+		PROFILE_FUNCTION();
+
 		//TODO
 		//Load SDL_Surface using IMG_LOAD
 		//Create & Return a new Texture Object (using SDL_Surface)
@@ -32,7 +35,7 @@ namespace dae
 		if (!surfacePtr)
 		{
 			std::cout << "Failed to load texture " << path << "! Error:\n" << IMG_GetError() << std::endl;
-			abort();
+			return nullptr;
 		}
 
 		return new Texture{ surfacePtr };
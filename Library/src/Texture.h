@@ -12,6 +12,7 @@ namespace dae
 	public:
 		~Texture();
 
+		// nullptr when the file could not be loaded, the reason is printed
 		static Texture* LoadFromFile(const std::string& path);
 		ColorRGB Sample(const Vector2& uv) const;
 
@@ -1,4 +1,7 @@
 #include "Timer.h"
+
+#include <algorithm>
+
 #include "SDL.h"
 using namespace dae;
 
@@ -17,6 +20,8 @@ void Timer::Reset()
 	m_StopTime = 0;
 	m_FPSTimer = 0.0f;
 	m_FPSCount = 0;
+	m_NumFrameTimes = 0;
+	m_NextFrameTime = 0;
 	m_IsStopped = false;
 }
 
@@ -60,6 +65,11 @@ void Timer::Update()
 
 	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
 
+	m_FrameTimes[m_NextFrameTime] = m_ElapsedTime;
+	m_NextFrameTime = (m_NextFrameTime + 1) % m_MaxFrameTimes;
+	if (m_NumFrameTimes < m_MaxFrameTimes)
+		++m_NumFrameTimes;
+
 	//FPS LOGIC
 	m_FPSTimer += m_ElapsedTime;
 	++m_FPSCount;
@@ -72,6 +82,18 @@ void Timer::Update()
 	}
 }
 
+float Timer::GetAverageElapsed(int numFrames) const
+{
+	numFrames = std::min(numFrames, m_NumFrameTimes);
+	if (numFrames <= 0)
+		return 0.0f;
+
+	float total = 0.0f;
+	for (int age = 0; age < numFrames; ++age)
+		total += m_FrameTimes[(m_NextFrameTime - 1 - age + m_MaxFrameTimes) % m_MaxFrameTimes];
+	return total / numFrames;
+}
+
 void Timer::Stop()
 {
 	if (!m_IsStopped)
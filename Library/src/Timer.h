@@ -27,6 +27,10 @@ namespace dae
 		float GetTotal() const { return m_TotalTime; };
 		bool IsRunning() const { return !m_IsStopped; };
 
+		// Average of the last numFrames elapsed times, as far as the history goes back, 0 before the first Update
+		float GetAverageElapsed(int numFrames) const;
+		int GetNumFrameTimes() const { return m_NumFrameTimes; };
+
 	private:
 		uint64_t m_BaseTime = 0;
 		uint64_t m_PausedTime = 0;
@@ -44,6 +48,12 @@ namespace dae
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
 
+		// Ring buffer of the last elapsed times, newest at m_NextFrameTime - 1
+		static constexpr int m_MaxFrameTimes = 64;
+		float m_FrameTimes[m_MaxFrameTimes]{};
+		int m_NumFrameTimes = 0;
+		int m_NextFrameTime = 0;
+
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
 	};
@@ -3,6 +3,7 @@
 #include <fstream>
 #include "Maths.h"
 #include "DataTypes.h"
+#include "Profiler.h"
 
 //#define DISABLE_OBJ
 
@@ -19,6 +20,7 @@ namespace dae
 			assert(false && "OBJ PARSER not enabled! Check the comments in Utils::ParseOBJ");
 
 #else
+			PROFILE_FUNCTION();
 
 			std::ifstream file(filename);
 			if (!file)
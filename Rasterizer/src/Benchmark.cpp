@@ -0,0 +1,142 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	struct StageField
+	{
+		const char* name;
+		double FrameTimings::* pStage;
+	};
+
+	constexpr StageField g_Stages[]
+	{
+		{ "clear", &FrameTimings::clear },
+		{ "vertex", &FrameTimings::vertex },
+		{ "setup", &FrameTimings::setup },
+		{ "raster", &FrameTimings::raster },
+		{ "shade", &FrameTimings::shade },
+		{ "resolve", &FrameTimings::resolve },
+		{ "present", &FrameTimings::present },
+	};
+}
+
+Benchmark::Benchmark(int numFrames, int numWarmupFrames) :
+	m_NumFrames(numFrames),
+	m_NumWarmupFrames(numWarmupFrames)
+{
+	m_FrameTimes.reserve(numFrames);
+	m_StageTimings.reserve(numFrames);
+}
+
+void Benchmark::AddFrame(double frameMs, const FrameTimings& timings)
+{
+	if (IsDone() || m_NumFramesAdded++ < m_NumWarmupFrames)
+		return;
+
+	m_FrameTimes.push_back(frameMs);
+	m_StageTimings.push_back(timings);
+}
+
+Benchmark::Statistics Benchmark::CalculateStatistics(std::vector<double> values)
+{
+	Statistics statistics{};
+	if (values.empty())
+		return statistics;
+
+	std::sort(values.begin(), values.end());
+
+	// Nearest rank percentile
+	auto percentile = [&](double p)
+		{
+			const size_t rank{ static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size()))) };
+			return values[std::clamp(rank, size_t{ 1 }, values.size()) - 1];
+		};
+
+	statistics.mean = std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+	statistics.p50 = percentile(50.0);
+	statistics.p95 = percentile(95.0);
+	statistics.p99 = percentile(99.0);
+	statistics.min = values.front();
+	statistics.max = values.back();
+
+	return statistics;
+}
+
+void Benchmark::PrintSummary() const
+{
+	const Statistics frame{ CalculateStatistics(m_FrameTimes) };
+
+	std::cout << "Benchmark: " << m_FrameTimes.size() << " frames, mean " << frame.mean << "ms, p50 " << frame.p50
+		<< "ms, p95 " << frame.p95 << "ms, p99 " << frame.p99 << "ms" << std::endl;
+
+	// Frame time is the throughput, latency is how old a frame's input is by the time it is presented
+	std::vector<double> latencies{};
+	for (const FrameTimings& timings : m_StageTimings)
+		latencies.push_back(timings.latency);
+	const Statistics latency{ CalculateStatistics(latencies) };
+
+	std::cout << "  throughput: " << (frame.mean > 0.0 ? 1000.0 / frame.mean : 0.0) << " frames/s, latency: mean " << latency.mean
+		<< "ms, p50 " << latency.p50 << "ms, p95 " << latency.p95 << "ms" << std::endl;
+
+	for (const StageField& stage : g_Stages)
+	{
+		std::vector<double> stageTimes{};
+		for (const FrameTimings& timings : m_StageTimings)
+			stageTimes.push_back(timings.*stage.pStage);
+
+		std::cout << "  " << stage.name << ": mean " << CalculateStatistics(stageTimes).mean << "ms" << std::endl;
+	}
+}
+
+bool Benchmark::WriteJson(const std::string& path, const std::string& config) const
+{
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	auto writeStatistics = [&](const Statistics& statistics)
+		{
+			file << "{ \"mean\": " << statistics.mean << ", \"p50\": " << statistics.p50 << ", \"p95\": " << statistics.p95
+				<< ", \"p99\": " << statistics.p99 << ", \"min\": " << statistics.min << ", \"max\": " << statistics.max << " }";
+		};
+
+	file << "{\n";
+	file << "  \"config\": " << config << ",\n";
+	file << "  \"frames\": " << m_FrameTimes.size() << ",\n";
+	file << "  \"warmup_frames\": " << m_NumWarmupFrames << ",\n";
+	file << "  \"frame_ms\": ";
+	writeStatistics(CalculateStatistics(m_FrameTimes));
+	file << ",\n";
+
+	std::vector<double> latencies{};
+	for (const FrameTimings& timings : m_StageTimings)
+		latencies.push_back(timings.latency);
+	file << "  \"latency_ms\": ";
+	writeStatistics(CalculateStatistics(latencies));
+	file << ",\n";
+	file << "  \"stages_ms\": {\n";
+
+	for (size_t i{}; i < std::size(g_Stages); ++i)
+	{
+		std::vector<double> stageTimes{};
+		for (const FrameTimings& timings : m_StageTimings)
+			stageTimes.push_back(timings.*g_Stages[i].pStage);
+
+		file << "    \"" << g_Stages[i].name << "\": ";
+		writeStatistics(CalculateStatistics(stageTimes));
+		file << (i + 1 < std::size(g_Stages) ? ",\n" : "\n");
+	}
+
+	file << "  }\n";
+	file << "}\n";
+
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	// Collects frame and stage timings over a fixed number of frames and reports percentiles
+	class Benchmark final
+	{
+	public:
+		Benchmark(int numFrames, int numWarmupFrames = 5);
+
+		// Warmup frames are counted but not recorded
+		void AddFrame(double frameMs, const FrameTimings& timings);
+		bool IsDone() const { return m_NumFramesAdded >= m_NumWarmupFrames + m_NumFrames; }
+
+		void PrintSummary() const;
+		// config is written as-is under "config", so it has to be a JSON object
+		bool WriteJson(const std::string& path, const std::string& config = "{}") const;
+
+	private:
+		struct Statistics
+		{
+			double mean{};
+			double p50{};
+			double p95{};
+			double p99{};
+			double min{};
+			double max{};
+		};
+		static Statistics CalculateStatistics(std::vector<double> values);
+
+		int m_NumFrames{};
+		int m_NumWarmupFrames{};
+		int m_NumFramesAdded{};
+
+		std::vector<double> m_FrameTimes{};
+		std::vector<FrameTimings> m_StageTimings{};
+	};
+}
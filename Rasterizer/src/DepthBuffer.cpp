@@ -0,0 +1,56 @@
+#include "DepthBuffer.h"
+
+#include <cstring>
+
+using namespace dae;
+
+DepthBuffer::~DepthBuffer()
+{
+	delete[] m_pData;
+}
+
+void DepthBuffer::Initialize(int width, int height, DepthFormat format)
+{
+	delete[] m_pData;
+
+	m_Width = width;
+	m_Height = height;
+	m_Format = format;
+
+	m_pData = new uint8_t[static_cast<size_t>(m_Width) * m_Height * GetBytesPerPixel()];
+	Clear(0, m_Width * m_Height);
+}
+
+void DepthBuffer::Clear(int index, int count)
+{
+	switch (m_Format)
+	{
+	case DepthFormat::Float32:
+		std::fill_n(reinterpret_cast<float*>(m_pData) + index, count, 1.f);
+		break;
+	case DepthFormat::Unorm24:
+		// Far plane is all bits set
+		std::memset(m_pData + index * 3, 0xFF, static_cast<size_t>(count) * 3);
+		break;
+	case DepthFormat::Unorm16:
+		std::fill_n(reinterpret_cast<uint16_t*>(m_pData) + index, count, uint16_t{ 0xFFFF });
+		break;
+	default:
+		break;
+	}
+}
+
+int DepthBuffer::GetBytesPerPixel() const
+{
+	switch (m_Format)
+	{
+	case DepthFormat::Float32:
+		return 4;
+	case DepthFormat::Unorm24:
+		return 3;
+	case DepthFormat::Unorm16:
+		return 2;
+	default:
+		return 0;
+	}
+}
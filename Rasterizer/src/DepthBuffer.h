@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+namespace dae
+{
+	enum class DepthFormat
+	{
+		Float32,
+		Unorm24,
+		Unorm16,
+
+		enumSize
+	};
+
+	// Depth buffer holding linear [0, 1] depth (0 at zNear, 1 at zFar) in a selectable storage format
+	class DepthBuffer final
+	{
+	public:
+		DepthBuffer() = default;
+		~DepthBuffer();
+
+		DepthBuffer(const DepthBuffer&) = delete;
+		DepthBuffer(DepthBuffer&&) noexcept = delete;
+		DepthBuffer& operator=(const DepthBuffer&) = delete;
+		DepthBuffer& operator=(DepthBuffer&&) noexcept = delete;
+
+		void Initialize(int width, int height, DepthFormat format);
+
+		// Resets count depth values starting at index to the far plane
+		void Clear(int index, int count);
+
+		// Writes depth01 and returns true when it is closer than the stored value
+		bool TestAndWrite(int index, float depth01)
+		{
+			depth01 = std::clamp(depth01, 0.f, 1.f);
+
+			switch (m_Format)
+			{
+			case DepthFormat::Float32:
+			{
+				float& stored{ reinterpret_cast<float*>(m_pData)[index] };
+				if (depth01 >= stored)
+					return false;
+
+				stored = depth01;
+				return true;
+			}
+			case DepthFormat::Unorm24:
+			{
+				// 3 bytes per pixel, little endian
+				// Float rounding can push depth01 = 1 to 2^24, keep it in 24 bits
+				const uint32_t quantized{ std::min(static_cast<uint32_t>(depth01 * m_MaxUnorm24 + .5f), 0xFFFFFFu) };
+				uint8_t* pStored{ m_pData + index * 3 };
+				const uint32_t stored{ pStored[0] | (uint32_t{ pStored[1] } << 8u) | (uint32_t{ pStored[2] } << 16u) };
+				if (quantized >= stored)
+					return false;
+
+				pStored[0] = static_cast<uint8_t>(quantized);
+				pStored[1] = static_cast<uint8_t>(quantized >> 8u);
+				pStored[2] = static_cast<uint8_t>(quantized >> 16u);
+				return true;
+			}
+			case DepthFormat::Unorm16:
+			{
+				const uint16_t quantized{ static_cast<uint16_t>(depth01 * m_MaxUnorm16 + .5f) };
+				uint16_t& stored{ reinterpret_cast<uint16_t*>(m_pData)[index] };
+				if (quantized >= stored)
+					return false;
+
+				stored = quantized;
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+		DepthFormat GetFormat() const { return m_Format; }
+		int GetBytesPerPixel() const;
+
+	private:
+		static constexpr float m_MaxUnorm24{ 16777215.f };
+		static constexpr float m_MaxUnorm16{ 65535.f };
+
+		DepthFormat m_Format{ DepthFormat::Float32 };
+		uint8_t* m_pData{};
+
+		int m_Width{};
+		int m_Height{};
+	};
+}
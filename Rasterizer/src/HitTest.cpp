@@ -4,7 +4,7 @@
 
 using namespace dae;
 
-float CrossZ(const Vector3& p0, const Vector3& p1, const Vector3& point)
+float HitTest::CrossZ(const Vector3& p0, const Vector3& p1, const Vector3& point)
 {
     return (p1.x - p0.x) * (point.y - p0.y)
         - (p1.y - p0.y) * (point.x - p0.x);
@@ -26,6 +26,11 @@ std::optional<Sample> HitTest::Trongle(const Vector3& fragPos, const Vertex& v0,
     if (weights.z > 0)
         return std::nullopt;
 
+    return Interpolate(weights, v0, v1, v2);
+}
+
+Sample HitTest::Interpolate(const Vector3& weights, const Vertex& v0, const Vertex& v1, const Vertex& v2)
+{
     const float totalWeight{ weights.x + weights.y + weights.z };
 
     // normalize
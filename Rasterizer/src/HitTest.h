@@ -5,5 +5,11 @@
 
 namespace HitTest
 {
+    // Edge function of p0 -> p1 at point, Trongle's three edges are inside when it is at most 0
+    float CrossZ(const dae::Vector3& p0, const dae::Vector3& p1, const dae::Vector3& point);
+
     std::optional<dae::Sample> Trongle(const dae::Vector3& fragPos, const dae::Vertex& v0, const dae::Vertex& v1, const dae::Vertex& v2);
+
+    // What Trongle returns for a point inside, from the three edge functions at that point in Trongle's order
+    dae::Sample Interpolate(const dae::Vector3& weights, const dae::Vertex& v0, const dae::Vertex& v1, const dae::Vertex& v2);
 }
\ No newline at end of file
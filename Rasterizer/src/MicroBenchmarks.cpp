@@ -0,0 +1,306 @@
+#include "MicroBenchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Camera.h"
+#include "DataTypes.h"
+#include "HitTest.h"
+#include "Maths.h"
+#include "Texture.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr const char* g_MeshPath{ "Resources/vehicle.obj" };
+	constexpr const char* g_TexturePath{ "Resources/vehicle_diffuse.png" };
+	constexpr int g_ScreenWidth{ 640 };
+	constexpr int g_ScreenHeight{ 480 };
+
+	// Every measurement repeats passes for at least this long, the median of the repetitions is reported
+	constexpr double g_MinRepetitionSeconds{ .02 };
+	constexpr int g_NumRepetitions{ 5 };
+
+	Matrix RandomWorldMatrix(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> angle{ -PI, PI };
+		std::uniform_real_distribution<float> offset{ -50.f, 50.f };
+		// Scales of at least 1 keep the determinant well clear of the singular check in Matrix::Inverse
+		std::uniform_real_distribution<float> scale{ 1.f, 2.f };
+
+		return Matrix::CreateScale(scale(random), scale(random), scale(random))
+			* Matrix::CreateRotation(angle(random), angle(random), angle(random))
+			* Matrix::CreateTranslation(offset(random), offset(random), offset(random));
+	}
+
+	// Same mapping as Renderer::TransformVertices, without the normal and tangent transforms
+	Vertex ToScreenSpace(const Vertex& vertex, const Matrix& worldViewProjection)
+	{
+		Vertex screenVertex{ vertex };
+
+		Vector4 position{ worldViewProjection.TransformPoint({ vertex.position, 1.f }) };
+		position.x /= position.w;
+		position.y /= position.w;
+		position.z /= position.w;
+
+		screenVertex.valid = position.x >= -1.f && position.x <= 1.f && position.y >= -1.f && position.y <= 1.f && position.z >= 0.f && position.z <= 1.f;
+		position.x = ((position.x + 1.f) / 2.f) * static_cast<float>(g_ScreenWidth);
+		position.y = ((1.f - position.y) / 2.f) * static_cast<float>(g_ScreenHeight);
+		screenVertex.position = position;
+
+		return screenVertex;
+	}
+}
+
+MicroBenchmarks::MicroBenchmarks(const std::string& filter) :
+	m_Filter(filter)
+{
+}
+
+template<typename Pass>
+void MicroBenchmarks::Measure(const char* name, int numElements, Pass&& pass)
+{
+	if (!m_Filter.empty() && std::string{ name }.find(m_Filter) == std::string::npos)
+		return;
+
+	using Clock = std::chrono::steady_clock;
+
+	// Warm up caches, then find a pass count that runs long enough to time reliably
+	m_Sink = pass();
+
+	int numPasses{ 1 };
+	for (;;)
+	{
+		const Clock::time_point start{ Clock::now() };
+		for (int i{}; i < numPasses; ++i)
+			m_Sink = pass();
+		const double seconds{ std::chrono::duration<double>(Clock::now() - start).count() };
+
+		if (seconds >= g_MinRepetitionSeconds)
+			break;
+		numPasses *= 2;
+	}
+
+	std::vector<double> nsPerElement{};
+	for (int repetition{}; repetition < g_NumRepetitions; ++repetition)
+	{
+		const Clock::time_point start{ Clock::now() };
+		for (int i{}; i < numPasses; ++i)
+			m_Sink = pass();
+		const double ns{ std::chrono::duration<double, std::nano>(Clock::now() - start).count() };
+
+		nsPerElement.push_back(ns / (static_cast<double>(numPasses) * numElements));
+	}
+
+	std::sort(nsPerElement.begin(), nsPerElement.end());
+	const double medianNs{ nsPerElement[nsPerElement.size() / 2] };
+
+	std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(10) << medianNs << " ns/op" << std::setw(12) << 1000.0 / medianNs << " M elements/s" << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+int MicroBenchmarks::Run()
+{
+	// Realistic streams come from the vehicle the renderer draws
+	std::vector<Vertex> meshVertices{};
+	std::vector<uint32_t> meshIndices{};
+	if (!Utils::ParseOBJ(g_MeshPath, meshVertices, meshIndices))
+	{
+		std::cout << "Failed to load mesh " << g_MeshPath << "!" << std::endl;
+		return 1;
+	}
+
+	std::mt19937 random{ 1337 };
+	const int numVertices{ static_cast<int>(meshVertices.size()) };
+
+	Camera camera{};
+	camera.Initialize(45.f, { 0.f, 5.f, -64.f });
+	camera.aspectRatio = static_cast<float>(g_ScreenWidth) / static_cast<float>(g_ScreenHeight);
+	camera.Update(0.f, false);
+	const Matrix viewProjection{ camera.viewMatrix * camera.projectionMatrix };
+
+	// Matrices, world * view * projection like the renderer builds per mesh
+	constexpr int numMatrices{ 1024 };
+	std::vector<Matrix> worldMatrices(numMatrices);
+	std::vector<Matrix> viewProjections(numMatrices, viewProjection);
+	std::vector<Matrix> worldViews(numMatrices);
+	std::vector<Matrix> worldViewProjections(numMatrices);
+	std::vector<Matrix> matrixResults(numMatrices);
+	for (int i{}; i < numMatrices; ++i)
+	{
+		worldMatrices[i] = RandomWorldMatrix(random);
+		worldViews[i] = worldMatrices[i] * camera.viewMatrix;
+		worldViewProjections[i] = worldMatrices[i] * viewProjection;
+	}
+
+	Measure("Matrix::operator*", numMatrices, [&]()
+		{
+			for (int i{}; i < numMatrices; ++i)
+				matrixResults[i] = worldMatrices[i] * viewProjections[i];
+			return matrixResults[numMatrices - 1][3].w;
+		});
+
+	// Inverted like the camera's view matrix, projections are close to singular for the determinant check
+	Measure("Matrix::Inverse", numMatrices, [&]()
+		{
+			for (int i{}; i < numMatrices; ++i)
+				matrixResults[i] = Matrix::Inverse(worldViews[i]);
+			return matrixResults[numMatrices - 1][3].w;
+		});
+
+	Measure("Matrix::InverseAffine", numMatrices, [&]()
+		{
+			for (int i{}; i < numMatrices; ++i)
+				matrixResults[i] = Matrix::InverseAffine(worldViews[i]);
+			return matrixResults[numMatrices - 1][3].w;
+		});
+
+	// Points, the mesh positions through one world * view * projection
+	std::vector<Vector4> points(numVertices);
+	std::vector<Vector4> transformedPoints(numVertices);
+	for (int i{}; i < numVertices; ++i)
+		points[i] = { meshVertices[i].position, 1.f };
+
+	Measure("Matrix::TransformPoint", numVertices, [&]()
+		{
+			const Matrix& worldViewProjection{ worldViewProjections[0] };
+			for (int i{}; i < numVertices; ++i)
+				transformedPoints[i] = worldViewProjection.TransformPoint(points[i]);
+			return transformedPoints[numVertices - 1].w;
+		});
+
+	Measure("Matrix::TransformPoints", numVertices, [&]()
+		{
+			worldViewProjections[0].TransformPoints(points, transformedPoints);
+			return transformedPoints[numVertices - 1].w;
+		});
+
+	// Vectors, unnormalized normals and triangle edges
+	std::uniform_real_distribution<float> lengthScale{ .1f, 10.f };
+	std::vector<Vector3> normals(numVertices);
+	std::vector<Vector3> edges(numVertices);
+	std::vector<Vector3> vectorResults(numVertices);
+	std::vector<float> dotResults(numVertices);
+	for (int i{}; i < numVertices; ++i)
+	{
+		normals[i] = meshVertices[i].normal * lengthScale(random);
+		edges[i] = Vector3{ meshVertices[i].position } - Vector3{ meshVertices[(i + 1) % numVertices].position };
+	}
+	const Vector3 lightDirection{ .577f, -.577f, .577f };
+
+	Measure("Vector3::Normalized", numVertices, [&]()
+		{
+			for (int i{}; i < numVertices; ++i)
+				vectorResults[i] = normals[i].Normalized();
+			return vectorResults[numVertices - 1].z;
+		});
+
+	Measure("Vector3::Cross", numVertices, [&]()
+		{
+			for (int i{}; i < numVertices; ++i)
+				vectorResults[i] = Vector3::Cross(normals[i], edges[i]);
+			return vectorResults[numVertices - 1].z;
+		});
+
+	Measure("Vector3::Dot", numVertices, [&]()
+		{
+			for (int i{}; i < numVertices; ++i)
+				dotResults[i] = Vector3::Dot(normals[i], lightDirection);
+			return dotResults[numVertices - 1];
+		});
+
+	// Screen space triangles of the vehicle and the pixel centers inside their bounding boxes, in raster order
+	struct PixelTest
+	{
+		Vector3 point;
+		int triangleIndex;
+	};
+	std::vector<Vertex> screenVertices(numVertices);
+	for (int i{}; i < numVertices; ++i)
+		screenVertices[i] = ToScreenSpace(meshVertices[i], viewProjection);
+
+	constexpr int maxPixelTests{ 1 << 18 };
+	std::vector<PixelTest> pixelTests{};
+	for (int triangleIndex{}; triangleIndex + 2 < static_cast<int>(meshIndices.size()) && static_cast<int>(pixelTests.size()) < maxPixelTests; triangleIndex += 3)
+	{
+		const Vertex& v0{ screenVertices[meshIndices[triangleIndex]] };
+		const Vertex& v1{ screenVertices[meshIndices[triangleIndex + 1]] };
+		const Vertex& v2{ screenVertices[meshIndices[triangleIndex + 2]] };
+		if (!v0.valid || !v1.valid || !v2.valid)
+			continue;
+
+		const int xMin{ static_cast<int>(std::min({ v0.position.x, v1.position.x, v2.position.x })) };
+		const int xMax{ static_cast<int>(std::max({ v0.position.x, v1.position.x, v2.position.x })) + 1 };
+		const int yMin{ static_cast<int>(std::min({ v0.position.y, v1.position.y, v2.position.y })) };
+		const int yMax{ static_cast<int>(std::max({ v0.position.y, v1.position.y, v2.position.y })) + 1 };
+
+		for (int px{ xMin }; px < xMax; ++px)
+			for (int py{ yMin }; py < yMax; ++py)
+				pixelTests.push_back({ { px + .5f, py + .5f, 0.f }, triangleIndex });
+	}
+
+	const int numPixelTests{ static_cast<int>(pixelTests.size()) };
+	std::vector<float> depthResults(numPixelTests);
+
+	Measure("HitTest::Trongle", numPixelTests, [&]()
+		{
+			for (int i{}; i < numPixelTests; ++i)
+			{
+				const int triangleIndex{ pixelTests[i].triangleIndex };
+				const std::optional<Sample> sample{ HitTest::Trongle(pixelTests[i].point, screenVertices[meshIndices[triangleIndex]],
+					screenVertices[meshIndices[triangleIndex + 1]], screenVertices[meshIndices[triangleIndex + 2]]) };
+				depthResults[i] = sample.has_value() ? sample.value().depth : -1.f;
+			}
+			return depthResults[numPixelTests - 1];
+		});
+
+	// Texture lookups of a rotated, scaled quad covering the screen, coherent like a rasterized surface
+	Texture* pTexture{ Texture::LoadFromFile(g_TexturePath) };
+	if (!pTexture)
+		return 1;
+
+	constexpr int numSamples{ 256 * 256 };
+	std::vector<Vector2> uvs(numSamples);
+	std::vector<ColorRGB> sampleResults(numSamples);
+	for (int i{}; i < numSamples; ++i)
+	{
+		const float u{ static_cast<float>(i % 256) / 256.f };
+		const float v{ static_cast<float>(i / 256) / 256.f };
+		uvs[i] = { std::clamp(.1f + .7f * u + .2f * v, 0.f, 1.f), std::clamp(.1f - .2f * u + .7f * v + .2f, 0.f, 1.f) };
+	}
+
+	Measure("Texture::Sample", numSamples, [&]()
+		{
+			for (int i{}; i < numSamples; ++i)
+				sampleResults[i] = pTexture->Sample(uvs[i]);
+			return sampleResults[numSamples - 1].g;
+		});
+
+	delete pTexture;
+
+	// HDR colors as they come out of the lighting, a share of them above 1
+	std::uniform_real_distribution<float> hdrValue{ 0.f, 3.f };
+	std::vector<ColorRGB> colors(numSamples);
+	std::vector<ColorRGB> colorResults(numSamples);
+	for (ColorRGB& color : colors)
+		color = { hdrValue(random), hdrValue(random), hdrValue(random) };
+
+	Measure("ColorRGB::MaxToOne", numSamples, [&]()
+		{
+			for (int i{}; i < numSamples; ++i)
+			{
+				colorResults[i] = colors[i];
+				colorResults[i].MaxToOne();
+			}
+			return colorResults[numSamples - 1].r;
+		});
+
+	return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	// Times the hot math and sampling primitives in isolation over realistic input streams
+	// Reports ns per element and elements per second, run before and after changing the layout or SIMD paths of these types
+	class MicroBenchmarks final
+	{
+	public:
+		// Only kernels whose name contains filter are run
+		explicit MicroBenchmarks(const std::string& filter = {});
+
+		// Non-zero when the input data could not be loaded
+		int Run();
+
+	private:
+		// pass processes numElements elements, returns a value from its output and is repeated until the measurement is long enough
+		template<typename Pass>
+		void Measure(const char* name, int numElements, Pass&& pass);
+
+		std::string m_Filter{};
+
+		// Read after every pass so the compiler cannot drop the work
+		volatile float m_Sink{};
+	};
+}
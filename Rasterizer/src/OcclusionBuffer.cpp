@@ -0,0 +1,150 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "HitTest.h"
+
+using namespace dae;
+
+void OcclusionBuffer::Initialize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Depth.resize(static_cast<size_t>(m_Width) * m_Height);
+	Clear();
+}
+
+void OcclusionBuffer::Clear()
+{
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.f);
+}
+
+bool OcclusionBuffer::SetupTriangle(const Vector4& corner0, const Vector4& corner1, const Vector4& corner2, bool isBackfaceCulled, Triangle& triangle) const
+{
+	const Vector4* corners[3]{ &corner0, &corner1, &corner2 };
+	Vector3 vertices[3]{};
+	for (int index{}; index < 3; ++index)
+	{
+		const Vector4& corner{ *corners[index] };
+		if (corner.w <= 0.f)
+			return false;
+
+		// Same test as the vertex stage, the renderer drops the triangle when any corner fails it
+		const Vector3 ndc{ corner.x / corner.w, corner.y / corner.w, corner.z / corner.w };
+		if (ndc.x < -1.f || ndc.x > 1.f || ndc.y < -1.f || ndc.y > 1.f || ndc.z < 0.f || ndc.z > 1.f)
+			return false;
+
+		vertices[index] = { (ndc.x + 1.f) * .5f * static_cast<float>(m_Width), (1.f - ndc.y) * .5f * static_cast<float>(m_Height), ndc.z };
+	}
+
+	// Positive for front faces, see the backface test in Renderer::SetupAndBinTriangles
+	const float signedArea{ (vertices[1].x - vertices[0].x) * (vertices[2].y - vertices[0].y) - (vertices[1].y - vertices[0].y) * (vertices[2].x - vertices[0].x) };
+	if (signedArea == 0.f || (isBackfaceCulled && signedArea < 0.f))
+		return false;
+
+	// HitTest::Trongle's winding, so every edge function is at most 0 inside
+	if (HitTest::CrossZ(vertices[2], vertices[1], vertices[0]) > 0.f)
+		std::swap(vertices[1], vertices[2]);
+
+	triangle.vertex0 = vertices[0];
+	triangle.vertex1 = vertices[1];
+	triangle.vertex2 = vertices[2];
+
+	// Depth over the screen is a plane, z / w is affine in screen space
+	const Vector3 edge1{ vertices[1] - vertices[0] };
+	const Vector3 edge2{ vertices[2] - vertices[0] };
+	const float area{ edge1.x * edge2.y - edge2.x * edge1.y };
+	triangle.depthDx = (edge1.z * edge2.y - edge2.z * edge1.y) / area;
+	triangle.depthDy = (edge2.z * edge1.x - edge1.z * edge2.x) / area;
+	triangle.maxDepth = std::max(vertices[0].z, std::max(vertices[1].z, vertices[2].z));
+
+	triangle.xMin = std::max(static_cast<int>(std::min(vertices[0].x, std::min(vertices[1].x, vertices[2].x))), 0);
+	triangle.yMin = std::max(static_cast<int>(std::min(vertices[0].y, std::min(vertices[1].y, vertices[2].y))), 0);
+	triangle.xMax = std::min(static_cast<int>(std::ceil(std::max(vertices[0].x, std::max(vertices[1].x, vertices[2].x)))), m_Width);
+	triangle.yMax = std::min(static_cast<int>(std::ceil(std::max(vertices[0].y, std::max(vertices[1].y, vertices[2].y)))), m_Height);
+	return triangle.xMin < triangle.xMax && triangle.yMin < triangle.yMax;
+}
+
+void OcclusionBuffer::RasterizeTriangle(const Triangle& triangle, int firstRow, int lastRow)
+{
+	const Vector3& v0{ triangle.vertex0 };
+	const Vector3& v1{ triangle.vertex1 };
+	const Vector3& v2{ triangle.vertex2 };
+
+	// Depth changes by at most this much from a pixel's center to its corners
+	const float depthMargin{ .5f * (std::abs(triangle.depthDx) + std::abs(triangle.depthDy)) };
+
+	const int yMin{ std::max(triangle.yMin, firstRow) };
+	const int yMax{ std::min(triangle.yMax, lastRow) };
+	for (int py{ yMin }; py < yMax; ++py)
+	{
+		for (int px{ triangle.xMin }; px < triangle.xMax; ++px)
+		{
+			const Vector3 point{ px + .5f, py + .5f, 0.f };
+
+			if (HitTest::CrossZ(v2, v1, point) > 0.f ||
+				HitTest::CrossZ(v0, v2, point) > 0.f ||
+				HitTest::CrossZ(v1, v0, point) > 0.f)
+				continue;
+
+			const float centerDepth{ v0.z + triangle.depthDx * (point.x - v0.x) + triangle.depthDy * (point.y - v0.y) };
+			const float farthestDepth{ std::min(centerDepth + depthMargin, triangle.maxDepth) };
+
+			float& stored{ m_Depth[px + py * m_Width] };
+			stored = std::min(stored, farthestDepth);
+		}
+	}
+}
+
+bool OcclusionBuffer::GetFootprint(const BoundingBox& box, const Matrix& viewProjectionMatrix, BoxFootprint& footprint) const
+{
+	float xMin{ 1.f };
+	float yMin{ 1.f };
+	float xMax{ -1.f };
+	float yMax{ -1.f };
+	footprint.minDepth = 1.f;
+
+	for (int corner{}; corner < 8; ++corner)
+	{
+		const Vector4 position{ corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z, 1.f };
+		const Vector4 projected{ viewProjectionMatrix.TransformPoint(position) };
+		if (projected.w <= 0.f)
+			return false;
+
+		const float depth{ projected.z / projected.w };
+		if (depth < 0.f)
+			return false;
+
+		xMin = std::min(xMin, projected.x / projected.w);
+		xMax = std::max(xMax, projected.x / projected.w);
+		yMin = std::min(yMin, projected.y / projected.w);
+		yMax = std::max(yMax, projected.y / projected.w);
+		footprint.minDepth = std::min(footprint.minDepth, depth);
+	}
+
+	// Every pixel the box's projection overlaps plus the border, buffer y goes down
+	footprint.xMin = std::clamp(static_cast<int>(std::floor((xMin + 1.f) * .5f * static_cast<float>(m_Width))) - 1, 0, m_Width);
+	footprint.xMax = std::clamp(static_cast<int>(std::ceil((xMax + 1.f) * .5f * static_cast<float>(m_Width))) + 1, 0, m_Width);
+	footprint.yMin = std::clamp(static_cast<int>(std::floor((1.f - yMax) * .5f * static_cast<float>(m_Height))) - 1, 0, m_Height);
+	footprint.yMax = std::clamp(static_cast<int>(std::ceil((1.f - yMin) * .5f * static_cast<float>(m_Height))) + 1, 0, m_Height);
+	return true;
+}
+
+bool OcclusionBuffer::IsOccluded(const BoxFootprint& footprint) const
+{
+	if (footprint.xMin >= footprint.xMax || footprint.yMin >= footprint.yMax)
+		return false;
+
+	for (int py{ footprint.yMin }; py < footprint.yMax; ++py)
+	{
+		const float* pRow{ m_Depth.data() + py * m_Width };
+		for (int px{ footprint.xMin }; px < footprint.xMax; ++px)
+		{
+			if (pRow[px] >= footprint.minDepth)
+				return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+
+#include "BoundingBox.h"
+#include "Maths.h"
+
+namespace dae
+{
+	// Low resolution depth of the chosen occluders, boxes that are completely behind it can skip the whole pipeline
+	// Coverage uses the renderer's rule, pixel centers inside the triangle, since small triangles hardly ever cover a whole pixel
+	// Depth is conservative: a covered pixel takes the farthest depth the triangle has inside it, and a box is tested with
+	// its nearest depth over every pixel it touches plus a one pixel border, for the part of a pixel an occluder edge leaves open
+	// Depth is z / w after projection, [0, 1] from the near to the far plane
+	class OcclusionBuffer final
+	{
+	public:
+		// Occluder triangle in buffer pixels, with its depth plane and the rows it touches
+		struct Triangle
+		{
+			Vector3 vertex0{};
+			Vector3 vertex1{};
+			Vector3 vertex2{};
+			float depthDx{};
+			float depthDy{};
+			float maxDepth{};
+			int xMin{};
+			int yMin{};
+			int xMax{};
+			int yMax{};
+		};
+
+		// Pixels a box covers and the nearest depth it has
+		struct BoxFootprint
+		{
+			int xMin{};
+			int yMin{};
+			int xMax{};
+			int yMax{};
+			float minDepth{};
+		};
+
+		void Initialize(int width, int height);
+		// Resets every pixel to the far plane
+		void Clear();
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+		// Corners in clip space, before the perspective divide, wound either way
+		// False for triangles the renderer would not draw either: with a corner outside the frustum, degenerate,
+		// or facing away when isBackfaceCulled, so occluders never hide what is behind a hole in the real image
+		bool SetupTriangle(const Vector4& corner0, const Vector4& corner1, const Vector4& corner2, bool isBackfaceCulled, Triangle& triangle) const;
+		// Only writes rows [firstRow, lastRow), so separate row ranges rasterize in parallel
+		void RasterizeTriangle(const Triangle& triangle, int firstRow, int lastRow);
+
+		// False when the box reaches behind the near plane, it can't be tested then
+		bool GetFootprint(const BoundingBox& box, const Matrix& viewProjectionMatrix, BoxFootprint& footprint) const;
+		bool IsOccluded(const BoxFootprint& footprint) const;
+
+	private:
+		std::vector<float> m_Depth{};
+		int m_Width{};
+		int m_Height{};
+	};
+}
@@ -0,0 +1,70 @@
+#include "Presenter.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+#include "SDL.h"
+#include "SDL_surface.h"
+
+using namespace dae;
+
+Presenter::Presenter(SDL_Window* pWindow, int width, int height, int numBackBuffers) :
+	m_pWindow(pWindow),
+	m_NumBackBuffers{ std::clamp(numBackBuffers, 2, m_MaxBackBuffers) }
+{
+	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+
+	for (int i{}; i < m_NumBackBuffers; ++i)
+	{
+		m_pBackBuffers[i] = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
+		m_FreeQueue.TryPush(m_pBackBuffers[i]);
+	}
+
+	m_PresentThread = std::thread{ &Presenter::PresentLoop, this };
+}
+
+Presenter::~Presenter()
+{
+	m_ReadyQueue.TryPush(nullptr);
+	m_PresentThread.join();
+
+	for (int i{}; i < m_NumBackBuffers; ++i)
+		SDL_FreeSurface(m_pBackBuffers[i]);
+}
+
+SDL_Surface* Presenter::AcquireBackBuffer()
+{
+	return m_FreeQueue.Pop();
+}
+
+void Presenter::Present(SDL_Surface* pBackBuffer)
+{
+	m_pLastBackBuffer = pBackBuffer;
+	++m_NumPresentsQueued;
+	m_ReadyQueue.TryPush(pBackBuffer);
+}
+
+void Presenter::WaitForPresent()
+{
+	uint64_t numDone{ m_NumPresentsDone.load(std::memory_order_acquire) };
+	while (numDone != m_NumPresentsQueued)
+	{
+		m_NumPresentsDone.wait(numDone, std::memory_order_acquire);
+		numDone = m_NumPresentsDone.load(std::memory_order_acquire);
+	}
+}
+
+void Presenter::PresentLoop()
+{
+	while (SDL_Surface* pBackBuffer{ m_ReadyQueue.Pop() })
+	{
+		PROFILE_SCOPE("Present");
+		SDL_BlitSurface(pBackBuffer, nullptr, m_pFrontBuffer, nullptr);
+		SDL_UpdateWindowSurface(m_pWindow);
+
+		m_FreeQueue.TryPush(pBackBuffer);
+		m_NumPresentsDone.fetch_add(1, std::memory_order_release);
+		m_NumPresentsDone.notify_one();
+	}
+}
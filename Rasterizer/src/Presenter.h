@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "SpscQueue.h"
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	// Owns the back buffers and presents them to the window on its own thread
+	// Rendering into one back buffer overlaps presenting the previous one
+	class Presenter final
+	{
+	public:
+		Presenter(SDL_Window* pWindow, int width, int height, int numBackBuffers = 3);
+		~Presenter();
+
+		Presenter(const Presenter&) = delete;
+		Presenter(Presenter&&) noexcept = delete;
+		Presenter& operator=(const Presenter&) = delete;
+		Presenter& operator=(Presenter&&) noexcept = delete;
+
+		// Blocks while every back buffer is still queued for present
+		SDL_Surface* AcquireBackBuffer();
+		void Present(SDL_Surface* pBackBuffer);
+		// Blocks until the present thread handed back every buffer passed to Present
+		void WaitForPresent();
+
+		// Most recent buffer handed to Present, the present thread may still be reading it until WaitForPresent returns
+		SDL_Surface* GetLastBackBuffer() const { return m_pLastBackBuffer; }
+
+	private:
+		static constexpr int m_MaxBackBuffers{ 3 };
+
+		void PresentLoop();
+
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pFrontBuffer{};
+
+		SDL_Surface* m_pBackBuffers[m_MaxBackBuffers]{};
+		int m_NumBackBuffers{};
+		SDL_Surface* m_pLastBackBuffer{};
+
+		// Free buffers flow from the present thread to the render thread, ready buffers the other way
+		// A nullptr in the ready queue stops the present thread
+		SpscQueue<SDL_Surface*, 4> m_FreeQueue{};
+		SpscQueue<SDL_Surface*, 4> m_ReadyQueue{};
+		// Buffers handed to Present by the render thread and handed back by the present thread
+		uint64_t m_NumPresentsQueued{};
+		std::atomic<uint64_t> m_NumPresentsDone{};
+
+		std::thread m_PresentThread{};
+	};
+}
@@ -0,0 +1,252 @@
+#include "RegressionSuite.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_surface.h"
+
+using namespace dae;
+
+namespace
+{
+	struct RegressionScene
+	{
+		const char* name;
+		SceneDescription scene;
+	};
+
+	const RegressionScene g_Scenes[]
+	{
+		{ "vehicle", SceneDescription{} },
+		{ "tuktuk", SceneDescription{ "Resources/tuktuk.obj", "Resources/tuktuk.png",
+			"Resources/vehicle_gloss.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png", { 0.f, 8.f, -40.f } } },
+	};
+
+	SDL_Surface* LoadBMP32(const std::string& path)
+	{
+		SDL_Surface* pLoaded{ SDL_LoadBMP(path.c_str()) };
+		if (!pLoaded)
+			return nullptr;
+
+		SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pLoaded, SDL_PIXELFORMAT_ARGB8888, 0) };
+		SDL_FreeSurface(pLoaded);
+		return pConverted;
+	}
+
+	// Fixed turntable angle so every case sees the mesh from the same side
+	constexpr float g_PoseRotation{ .8f };
+}
+
+RegressionSuite::RegressionSuite(const Settings& settings) :
+	m_Settings(settings)
+{
+}
+
+int RegressionSuite::Run()
+{
+	std::vector<Case> cases{};
+	for (const bool useNormals : { true, false })
+	{
+		const std::string normalsSuffix{ useNormals ? "_normals" : "_flat" };
+		cases.push_back({ "observedarea" + normalsSuffix, Renderer::LightingMode::ObservedArea, useNormals, false });
+		cases.push_back({ "diffuse" + normalsSuffix, Renderer::LightingMode::Diffuse, useNormals, false });
+		cases.push_back({ "specular" + normalsSuffix, Renderer::LightingMode::Specular, useNormals, false });
+		cases.push_back({ "combined" + normalsSuffix, Renderer::LightingMode::Combined, useNormals, false });
+	}
+	// Depth view ignores lighting mode and normals
+	cases.push_back({ "depth", Renderer::LightingMode::Combined, true, true });
+
+	if (!m_Settings.updateReferences && !LoadBudgets())
+		std::cout << "No budgets in " << GetBudgetsPath() << ", frame times are reported but not checked" << std::endl;
+
+	int numFailed{};
+	int numCases{};
+	for (const RegressionScene& scene : g_Scenes)
+	{
+		Renderer renderer{ m_Settings.width, m_Settings.height, scene.scene };
+		if (!renderer.IsLoaded())
+		{
+			// Every case of the scene fails, the other scenes still run
+			for (const Case& testCase : cases)
+			{
+				std::cout << "FAIL " << scene.name << "_" << testCase.name << ": scene failed to load" << std::endl;
+				++numCases;
+				++numFailed;
+			}
+			continue;
+		}
+
+		renderer.SetInputEnabled(false);
+		renderer.Update(g_PoseRotation);
+		renderer.SetRotation(false);
+
+		for (const Case& testCase : cases)
+		{
+			++numCases;
+			if (!RunCase(renderer, scene.name, testCase))
+				++numFailed;
+		}
+	}
+
+	if (m_Settings.updateReferences)
+	{
+		if (!SaveBudgets())
+		{
+			std::cout << "Failed to write " << GetBudgetsPath() << "!" << std::endl;
+			return 1;
+		}
+
+		std::cout << "Updated " << numCases << " reference(s) and budgets in " << m_Settings.directory << std::endl;
+		return numFailed;
+	}
+
+	std::cout << "Regression: " << numCases - numFailed << "/" << numCases << " passed" << std::endl;
+	return numFailed;
+}
+
+bool RegressionSuite::RunCase(Renderer& renderer, const std::string& sceneName, const Case& testCase)
+{
+	const std::string name{ sceneName + "_" + testCase.name };
+
+	renderer.SetLightingMode(testCase.lightingMode);
+	renderer.SetUseNormals(testCase.useNormals);
+	renderer.SetDepthBufferView(testCase.isDepthBuffer);
+
+	// First frame is not timed, it warms up caches and every frame renders the same image anyway
+	renderer.Update(0.f);
+	renderer.Render();
+
+	const double msPerCount{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) };
+	std::vector<double> frameTimes{};
+	for (int i{}; i < m_Settings.numTimedFrames; ++i)
+	{
+		const uint64_t frameStart{ SDL_GetPerformanceCounter() };
+		renderer.Update(0.f);
+		renderer.Render();
+		frameTimes.push_back(static_cast<double>(SDL_GetPerformanceCounter() - frameStart) * msPerCount);
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	const double medianMs{ frameTimes.empty() ? 0.0 : frameTimes[frameTimes.size() / 2] };
+
+	const std::string referencePath{ m_Settings.directory + "/" + name + ".bmp" };
+	if (m_Settings.updateReferences)
+	{
+		m_Budgets[name] = medianMs;
+		if (renderer.SaveBufferToImage(referencePath))
+		{
+			std::cout << "FAIL " << name << ": could not write " << referencePath << std::endl;
+			return false;
+		}
+
+		std::cout << "UPDATED " << name << ": median " << medianMs << "ms" << std::endl;
+		return true;
+	}
+
+	// Kept next to the reference when the case fails, so the two can be compared
+	const std::string actualPath{ m_Settings.directory + "/" + name + "_actual.bmp" };
+	if (renderer.SaveBufferToImage(actualPath))
+	{
+		std::cout << "FAIL " << name << ": could not write " << actualPath << std::endl;
+		return false;
+	}
+
+	float mismatchRatio{};
+	const bool isImageLoaded{ CompareImages(referencePath, actualPath, mismatchRatio) };
+	const bool isImageMatch{ isImageLoaded && mismatchRatio <= m_Settings.maxMismatchRatio };
+
+	const auto budget = m_Budgets.find(name);
+	const bool hasBudget{ budget != m_Budgets.end() };
+	const double maxMs{ hasBudget ? budget->second * (1.0 + m_Settings.budgetMargin) : 0.0 };
+	const bool isWithinBudget{ !hasBudget || medianMs <= maxMs };
+
+	const bool isPass{ isImageMatch && isWithinBudget };
+	if (isPass)
+		std::remove(actualPath.c_str());
+
+	std::cout << (isPass ? "PASS " : "FAIL ") << name << ": ";
+	if (isImageLoaded)
+		std::cout << mismatchRatio * 100.f << "% pixels differ";
+	else
+		std::cout << "missing or unreadable reference " << referencePath;
+	std::cout << ", median " << medianMs << "ms";
+	if (hasBudget)
+		std::cout << " (budget " << budget->second << "ms, max " << maxMs << "ms)";
+	std::cout << std::endl;
+
+	return isPass;
+}
+
+bool RegressionSuite::CompareImages(const std::string& referencePath, const std::string& actualPath, float& mismatchRatio) const
+{
+	// BMPs load as 24 bit, compare them as packed 32 bit pixels
+	SDL_Surface* pReference{ LoadBMP32(referencePath) };
+	SDL_Surface* pActual{ LoadBMP32(actualPath) };
+
+	const bool isComparable{ pReference && pActual && pReference->w == pActual->w && pReference->h == pActual->h };
+	if (isComparable)
+	{
+		int numMismatches{};
+		for (int y{}; y < pActual->h; ++y)
+		{
+			const uint32_t* pReferenceRow{ reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pReference->pixels) + y * pReference->pitch) };
+			const uint32_t* pActualRow{ reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pActual->pixels) + y * pActual->pitch) };
+
+			for (int x{}; x < pActual->w; ++x)
+			{
+				uint8_t referenceRGB[3]{};
+				uint8_t actualRGB[3]{};
+				SDL_GetRGB(pReferenceRow[x], pReference->format, &referenceRGB[0], &referenceRGB[1], &referenceRGB[2]);
+				SDL_GetRGB(pActualRow[x], pActual->format, &actualRGB[0], &actualRGB[1], &actualRGB[2]);
+
+				for (int channel{}; channel < 3; ++channel)
+				{
+					if (std::abs(referenceRGB[channel] - actualRGB[channel]) > m_Settings.tolerance)
+					{
+						++numMismatches;
+						break;
+					}
+				}
+			}
+		}
+
+		mismatchRatio = static_cast<float>(numMismatches) / static_cast<float>(pActual->w * pActual->h);
+	}
+
+	SDL_FreeSurface(pReference);
+	SDL_FreeSurface(pActual);
+
+	return isComparable;
+}
+
+bool RegressionSuite::LoadBudgets()
+{
+	std::ifstream file{ GetBudgetsPath() };
+	if (!file)
+		return false;
+
+	// One "<case> <median ms>" pair per line
+	std::string name{};
+	double medianMs{};
+	while (file >> name >> medianMs)
+		m_Budgets[name] = medianMs;
+
+	return true;
+}
+
+bool RegressionSuite::SaveBudgets() const
+{
+	std::ofstream file{ GetBudgetsPath() };
+	if (!file)
+		return false;
+
+	for (const auto& [name, medianMs] : m_Budgets)
+		file << name << " " << medianMs << "\n";
+
+	return static_cast<bool>(file);
+}
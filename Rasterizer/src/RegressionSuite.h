@@ -0,0 +1,57 @@
+#pragma once
+#include <map>
+#include <string>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	// Renders fixed scenes headless and checks them against stored reference images and median frame time budgets
+	// References and budgets are machine specific, regenerate them with updateReferences on the machine that runs the suite
+	class RegressionSuite final
+	{
+	public:
+		struct Settings
+		{
+			std::string directory{ "Resources/Regression" };
+			int width{ 320 };
+			int height{ 240 };
+			int numTimedFrames{ 31 };
+
+			// A pixel mismatches when any channel differs by more than this
+			int tolerance{ 8 };
+			// Share of mismatching pixels a case may have, absorbs edge pixels flipping between compilers
+			float maxMismatchRatio{ .002f };
+			// Allowed median frame time over the stored budget, .25f is 25% slower
+			float budgetMargin{ .25f };
+
+			// Writes references and budgets instead of checking them
+			bool updateReferences{ false };
+		};
+
+		explicit RegressionSuite(const Settings& settings);
+
+		// Number of failed cases
+		int Run();
+
+	private:
+		struct Case
+		{
+			std::string name;
+			Renderer::LightingMode lightingMode;
+			bool useNormals;
+			bool isDepthBuffer;
+		};
+
+		bool RunCase(Renderer& renderer, const std::string& sceneName, const Case& testCase);
+		bool CompareImages(const std::string& referencePath, const std::string& actualPath, float& mismatchRatio) const;
+
+		bool LoadBudgets();
+		bool SaveBudgets() const;
+		std::string GetBudgetsPath() const { return m_Settings.directory + "/budgets.txt"; }
+
+		Settings m_Settings{};
+		// Median frame time in ms per case
+		std::map<std::string, double> m_Budgets{};
+	};
+}
@@ -5,50 +5,145 @@
 //Project includes
 #include "Renderer.h"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 
+#include "Frustum.h"
 #include "HitTest.h"
+#include "JobSystem.h"
 #include "Maths.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "Presenter.h"
+#include "Profiler.h"
+#include "Resolve.h"
 #include "Texture.h"
 #include "Utils.h"
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window* pWindow) :
+namespace
+{
+	// Blue for a single shade, through green and yellow to red, white once it goes past the ramp
+	ColorRGB OverdrawColor(int shadeCount)
+	{
+		constexpr ColorRGB ramp[]
+		{
+			{ 0.f, 0.f, .6f },
+			{ 0.f, .4f, 1.f },
+			{ 0.f, .8f, .6f },
+			{ .2f, 1.f, 0.f },
+			{ .8f, 1.f, 0.f },
+			{ 1.f, .7f, 0.f },
+			{ 1.f, .3f, 0.f },
+			{ 1.f, 0.f, 0.f },
+		};
+		constexpr int rampSize{ static_cast<int>(std::size(ramp)) };
+
+		return shadeCount > rampSize ? colors::White : ramp[shadeCount - 1];
+	}
+}
+
+Renderer::Renderer(SDL_Window* pWindow, const SceneDescription& scene) :
 	m_pWindow(pWindow)
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 
 	//Create Buffers
-	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = static_cast<uint32_t*>(m_pBackBuffer->pixels);
+	m_pPresenter = new Presenter(pWindow, m_Width, m_Height);
+
+	Initialize(scene);
+}
+
+Renderer::Renderer(int width, int height, const SceneDescription& scene) :
+	m_Width(width),
+	m_Height(height)
+{
+	//Create Buffers, plain memory surface, no video subsystem needed
+	m_pOffscreenBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+
+	Initialize(scene);
+}
 
-	m_pDepthBufferPixels = new float[static_cast<int>(m_Width * m_Height)];
+void Renderer::Initialize(const SceneDescription& scene)
+{
+	m_DepthBuffer.Initialize(m_Width, m_Height, DepthFormat::Float32);
+
+	m_pColorBufferPixels = new float[static_cast<int>(m_Width * m_Height) * 3];
+	m_pColorBufferRed = m_pColorBufferPixels;
+	m_pColorBufferGreen = m_pColorBufferRed + m_Width * m_Height;
+	m_pColorBufferBlue = m_pColorBufferGreen + m_Width * m_Height;
+
+	m_pMotionBufferPixels = new float[static_cast<int>(m_Width * m_Height) * 2];
+	m_pMotionBufferX = m_pMotionBufferPixels;
+	m_pMotionBufferY = m_pMotionBufferX + m_Width * m_Height;
+
+	m_NumTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NumTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_TileCleared.resize(m_NumTilesX * m_NumTilesY);
+	m_TileStatistics.resize(m_NumTilesX * m_NumTilesY);
+	m_TileTimings.resize(m_NumTilesX * m_NumTilesY);
+	m_TileShadingRates.resize(m_NumTilesX * m_NumTilesY, ShadingRate::Rate1x1);
+
+	m_ShadeCounts.resize(m_Width * m_Height);
+	m_OcclusionBuffer.Initialize(m_OcclusionBufferWidth, std::max(1, m_OcclusionBufferWidth * m_Height / m_Width));
 
 	//Initialize Camera
-	m_Camera.Initialize(45.f, { 0.f, 5.f, -64.f });
+	m_Camera.Initialize(scene.fovAngle, scene.cameraOrigin);
 	m_Camera.aspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 
+	// Mesh and textures load side by side, as children of one job to wait on
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
+	const JobHandle pLoadAssets{ jobSystem.CreateJob([] {}) };
+
 	//Initialize Mesh
 	Mesh tempMesh{};
-	//Utils::ParseOBJ("Resources/tuktuk.obj", tempMesh.vertices, tempMesh.indices);
-	Utils::ParseOBJ("Resources/vehicle.obj", tempMesh.vertices, tempMesh.indices);
+	bool isMeshLoaded{};
+	jobSystem.Submit(jobSystem.CreateJob([&]()
+		{
+			isMeshLoaded = Utils::ParseOBJ(scene.meshPath, tempMesh.vertices, tempMesh.indices);
+			// Levels of detail are built while the textures are still loading
+			if (isMeshLoaded)
+				MeshSimplifier::BuildLods(tempMesh, m_MaxLods);
+		}, pLoadAssets));
+
+	jobSystem.Submit(jobSystem.CreateJob([&]() { m_VehicleDiffusePtr = Texture::LoadFromFile(scene.diffusePath); }, pLoadAssets));
+	jobSystem.Submit(jobSystem.CreateJob([&]() { m_VehicleGlossPtr = Texture::LoadFromFile(scene.glossPath); }, pLoadAssets));
+	jobSystem.Submit(jobSystem.CreateJob([&]() { m_VehicleNormalPtr = Texture::LoadFromFile(scene.normalPath); }, pLoadAssets));
+	jobSystem.Submit(jobSystem.CreateJob([&]() { m_VehicleSpecularPtr = Texture::LoadFromFile(scene.specularPath); }, pLoadAssets));
+
+	jobSystem.Submit(pLoadAssets);
+	jobSystem.Wait(pLoadAssets);
+
+	// Reported to the caller, a bad path from the command line should not take the process down
+	if (!isMeshLoaded)
+	{
+		std::cout << "Failed to load mesh " << scene.meshPath << "!" << std::endl;
+		return;
+	}
 
-	m_Meshes.push_back(tempMesh);
+	if (!m_VehicleDiffusePtr || !m_VehicleGlossPtr || !m_VehicleNormalPtr || !m_VehicleSpecularPtr)
+		return;
+
+	for (const Vertex& vertex : tempMesh.vertices)
+		tempMesh.bounds.Grow(vertex.position);
 
-	//m_VehicleDiffusePtr = Texture::LoadFromFile("./Resources/tuktuk.png");
-	m_VehicleDiffusePtr = Texture::LoadFromFile("./Resources/vehicle_diffuse.png");
-	m_VehicleGlossPtr = Texture::LoadFromFile("./Resources/vehicle_gloss.png");
-	m_VehicleNormalPtr = Texture::LoadFromFile("./Resources/vehicle_normal.png");
-	m_VehicleSpecularPtr = Texture::LoadFromFile("./Resources/vehicle_specular.png");
+	tempMesh.instances = scene.instances;
+	m_Meshes.push_back(tempMesh);
+	m_IsLoaded = true;
 }
 
 Renderer::~Renderer()
 {
-	delete[] m_pDepthBufferPixels;
+	Flush();
+
+	delete m_pPresenter;
+	SDL_FreeSurface(m_pOffscreenBuffer);
+	delete[] m_pColorBufferPixels;
+	delete[] m_pMotionBufferPixels;
+	delete[] m_pSampleBufferPixels;
 
 	delete m_VehicleDiffusePtr;
 	delete m_VehicleGlossPtr;
@@ -58,79 +153,861 @@ Renderer::~Renderer()
 
 void Renderer::Update(const Timer* pTimer)
 {
-	m_Camera.Update(pTimer);
+	Update(pTimer->GetElapsed());
+	UpdateResolutionScale(pTimer);
+}
+
+void Renderer::UpdateResolutionScale(const Timer* pTimer)
+{
+	if (m_FrameTimeTarget <= 0.f)
+		return;
+
+	// Frame times only say something about a scale once a full window of frames ran at it
+	if (++m_FramesAtResolution < m_FrameTimeWindow || pTimer->GetNumFrameTimes() < m_FrameTimeWindow)
+		return;
+
+	const float frameTime{ pTimer->GetAverageElapsed(m_FrameTimeWindow) * 1000.f };
+	const float comfortableTime{ m_FrameTimeTarget * m_ResolutionHeadroom };
+	if (frameTime <= 0.f || (frameTime <= m_FrameTimeTarget && (frameTime >= comfortableTime || m_ResolutionScale >= 1.f)))
+		return;
+
+	const float step{ std::min(std::sqrt(comfortableTime / frameTime), m_MaxResolutionStep) };
+	// Whole percents, so small jitter in the frame times does not keep changing the buffer size
+	const float scale{ std::round(std::clamp(m_ResolutionScale * step, m_MinResolutionScale, 1.f) * 100.f) / 100.f };
+	if (scale != m_ResolutionScale)
+	{
+		m_ResolutionScale = scale;
+		m_FramesAtResolution = 0;
+	}
+}
+
+void Renderer::Update(float elapsedSec)
+{
+	// Headless renders have no keyboard or mouse to read
+	m_Camera.Update(elapsedSec, m_pWindow != nullptr && m_IsInputEnabled);
+	m_UpdateCounter = SDL_GetPerformanceCounter();
 
 	if (m_ShouldSpin)
 	{
-		m_TotalRotation += pTimer->GetElapsed();
-		m_Meshes[0].worldMatrix = Matrix::CreateRotationY(m_TotalRotation);
+		m_TotalRotation += elapsedSec;
+		m_SpinRotation = Matrix::CreateRotationY(m_TotalRotation);
+		m_AreInstanceBoundsDirty = true;
 	}
 }
 
 void Renderer::Render()
 {
-	//@START
-	// Lock BackBuffer
-	SDL_LockSurface(m_pBackBuffer);
-	SDL_FillRect(m_pBackBuffer, nullptr, m_ClearColor);
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, std::numeric_limits<float>::max());
+	PROFILE_FRAME();
+	PROFILE_FUNCTION();
 
-	// RENDER LOGIC
-	ColorRGB finalColor{};
-	constexpr int numVertices{ 3 };
+	FrameData& frame{ m_Frames[m_FrontEndFrame] };
+	RenderFrontEnd(frame);
+
+	if (!m_IsPipelined)
+	{
+		RenderBackEnd(frame);
+		PublishFrame(frame);
+		return;
+	}
+
+	// The back end of the previous frame still owns the color, depth and back buffers
+	Flush();
+
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
+	m_BackEndFrame = m_FrontEndFrame;
+	m_pBackEndJob = jobSystem.CreateJob([this, &frame]() { RenderBackEnd(frame); });
+	jobSystem.Submit(m_pBackEndJob);
+
+	// The next front end fills the other FrameData while this back end runs
+	m_FrontEndFrame = 1 - m_FrontEndFrame;
+}
+
+void Renderer::Flush()
+{
+	if (!m_pBackEndJob)
+		return;
+
+	JobSystem::GetInstance().Wait(m_pBackEndJob);
+	m_pBackEndJob = nullptr;
+
+	PublishFrame(m_Frames[m_BackEndFrame]);
+}
+
+void Renderer::SetPipelined(bool isPipelined)
+{
+	Flush();
+	m_IsPipelined = isPipelined;
+}
+
+void Renderer::PublishFrame(const FrameData& frame)
+{
+	m_FrameTimings = frame.timings;
+	m_PipelineStatistics = frame.statistics;
+	m_ArenaStatistics = frame.arena.GetStatistics();
+}
+
+void Renderer::UpdateSceneBvh()
+{
+	PROFILE_FUNCTION();
 
-	std::vector<Vertex> screenSpaceVec{};
-	for (Mesh& currentMesh : m_Meshes)
+	if (m_IsSceneBvhStale)
 	{
-		const Matrix worldViewProjectionMatrix{ currentMesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+		m_SceneInstances.clear();
+		for (int meshIndex{}; meshIndex < static_cast<int>(m_Meshes.size()); ++meshIndex)
+		{
+			for (int instanceIndex{}; instanceIndex < static_cast<int>(m_Meshes[meshIndex].instances.size()); ++instanceIndex)
+				m_SceneInstances.push_back({ meshIndex, instanceIndex });
+		}
+		m_InstanceBounds.resize(m_SceneInstances.size());
+		m_InstanceLods.assign(m_SceneInstances.size(), 0);
+	}
+	else if (!m_AreInstanceBoundsDirty)
+		return;
+
+	for (size_t index{}; index < m_SceneInstances.size(); ++index)
+	{
+		const Mesh& mesh{ m_Meshes[m_SceneInstances[index].meshIndex] };
+		const MeshInstance& instance{ mesh.instances[m_SceneInstances[index].instanceIndex] };
+		m_InstanceBounds[index] = mesh.bounds.Transformed(m_SpinRotation * instance.worldMatrix);
+	}
+
+	if (m_IsSceneBvhStale)
+		m_SceneBvh.Build(m_InstanceBounds);
+	else
+		m_SceneBvh.Refit(m_InstanceBounds);
+
+	m_IsSceneBvhStale = false;
+	m_AreInstanceBoundsDirty = false;
+}
+
+void Renderer::CullOccludedInstances(FrameData& frame, const Frustum& frustum, const Matrix& viewProjectionMatrix, ArenaVector<uint8_t>& isInstanceVisible)
+{
+	PROFILE_FUNCTION();
+
+	LinearArena& arena{ frame.arena.GetThreadArena() };
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
 
-		VertexTransformationFunction(currentMesh.worldMatrix, worldViewProjectionMatrix, currentMesh.vertices, currentMesh.vertices_out);
+	ArenaVector<int> visibleInstances{ arena };
+	for (int index{}; index < static_cast<int>(isInstanceVisible.size()); ++index)
+	{
+		if (isInstanceVisible[index])
+			visibleInstances.push_back(index);
+	}
 
-		int numTriangles;
-		Vertex vertex0, vertex1, vertex2;
+	// A single instance has nothing to hide behind
+	const int numVisible{ static_cast<int>(visibleInstances.size()) };
+	if (numVisible < 2)
+		return;
+
+	ArenaVector<OcclusionBuffer::BoxFootprint> footprints(numVisible, OcclusionBuffer::BoxFootprint{}, arena);
+	ArenaVector<uint8_t> hasFootprint(numVisible, uint8_t{ 0 }, arena);
+	jobSystem.ParallelFor(0, numVisible, [&](int first, int last)
+		{
+			for (int visible{ first }; visible < last; ++visible)
+				hasFootprint[visible] = m_OcclusionBuffer.GetFootprint(m_InstanceBounds[visibleInstances[visible]], viewProjectionMatrix, footprints[visible]);
+		}, 64);
 
-		switch (currentMesh.primitiveTopology)
+	// The instances covering the most pixels occlude, the ones reaching behind the near plane count as covering the screen
+	const int numPixels{ m_OcclusionBuffer.GetWidth() * m_OcclusionBuffer.GetHeight() };
+	const auto getArea = [&](int visible)
 		{
-		case PrimitiveTopology::TriangleList:
-			numTriangles = static_cast<int>(currentMesh.indices.size()) / numVertices;
-			break;
-		case PrimitiveTopology::TriangleStrip:
-			numTriangles = static_cast<int>(currentMesh.indices.size()) - 2;
-			break;
-		default:
-			abort();
+			const OcclusionBuffer::BoxFootprint& footprint{ footprints[visible] };
+			return hasFootprint[visible] ? (footprint.xMax - footprint.xMin) * (footprint.yMax - footprint.yMin) : numPixels;
+		};
+
+	ArenaVector<int> occluders(numVisible, 0, arena);
+	for (int visible{}; visible < numVisible; ++visible)
+		occluders[visible] = visible;
+
+	const int numOccluders{ std::min(m_MaxOccluders, numVisible) };
+	std::partial_sort(occluders.begin(), occluders.begin() + numOccluders, occluders.end(),
+		[&getArea](int left, int right) { return getArea(left) > getArea(right); });
+
+	// Their meshlets that are not outside the frustum, set up by one job each like the binning chunks
+	struct OccluderMeshlet
+	{
+		int sceneIndex{};
+		int meshletIndex{};
+		Matrix worldViewProjectionMatrix{};
+	};
+	ArenaVector<OccluderMeshlet> occluderMeshlets{ arena };
+	for (int occluder{}; occluder < numOccluders; ++occluder)
+	{
+		const int sceneIndex{ visibleInstances[occluders[occluder]] };
+		const Mesh& mesh{ m_Meshes[m_SceneInstances[sceneIndex].meshIndex] };
+		const Matrix worldMatrix{ m_SpinRotation * mesh.instances[m_SceneInstances[sceneIndex].instanceIndex].worldMatrix };
+		const Matrix worldViewProjectionMatrix{ worldMatrix * viewProjectionMatrix };
+		const float radiusScale{ worldMatrix.GetMaxAxisScale() };
+
+		// The level the instance is drawn with, a coarser one could stick out in front of what is really drawn
+		const MeshLod& lod{ mesh.lods[m_InstanceLods[sceneIndex]] };
+		for (int meshletIndex{}; meshletIndex < static_cast<int>(lod.meshlets.size()); ++meshletIndex)
+		{
+			const Meshlet& meshlet{ lod.meshlets[meshletIndex] };
+			if (!frustum.IsOutside(worldMatrix.TransformPoint(meshlet.center), meshlet.radius * radiusScale))
+				occluderMeshlets.push_back({ sceneIndex, meshletIndex, worldViewProjectionMatrix });
 		}
+	}
 
-		for (int triangleIndex{}; triangleIndex < numTriangles; triangleIndex++)
+	const int numOccluderMeshlets{ static_cast<int>(occluderMeshlets.size()) };
+	ArenaVector<ArenaVector<OcclusionBuffer::Triangle>> occluderTriangles{ arena };
+	occluderTriangles.resize(numOccluderMeshlets);
+
+	const bool cullBackfaces{ frame.settings.cullBackfaces };
+	jobSystem.ParallelFor(0, numOccluderMeshlets, [&](int first, int last)
 		{
-			Vertex vertex0, vertex1, vertex2;
+			for (int index{ first }; index < last; ++index)
+			{
+				const OccluderMeshlet& occluderMeshlet{ occluderMeshlets[index] };
+				const Mesh& mesh{ m_Meshes[m_SceneInstances[occluderMeshlet.sceneIndex].meshIndex] };
+				const MeshLod& lod{ mesh.lods[m_InstanceLods[occluderMeshlet.sceneIndex]] };
+				const Meshlet& meshlet{ lod.meshlets[occluderMeshlet.meshletIndex] };
+
+				Vector4 clipPositions[MeshletBuilder::maxVertices];
+				for (uint32_t vertex{}; vertex < meshlet.numVertices; ++vertex)
+					clipPositions[vertex] = occluderMeshlet.worldViewProjectionMatrix.TransformPoint(mesh.vertices[lod.meshletVertices[meshlet.firstVertex + vertex]].position);
+
+				ArenaVector<OcclusionBuffer::Triangle>& triangles{ occluderTriangles[index] };
+				triangles = ArenaVector<OcclusionBuffer::Triangle>{ frame.arena.GetThreadArena() };
+				triangles.reserve(meshlet.numTriangles);
 
-			switch (currentMesh.primitiveTopology)
+				const uint8_t* pTriangles{ lod.meshletTriangles.data() + meshlet.firstTriangle * 3 };
+				for (uint32_t triangle{}; triangle < meshlet.numTriangles; ++triangle)
+				{
+					OcclusionBuffer::Triangle setupTriangle{};
+					if (m_OcclusionBuffer.SetupTriangle(clipPositions[pTriangles[triangle * 3]], clipPositions[pTriangles[triangle * 3 + 1]],
+						clipPositions[pTriangles[triangle * 3 + 2]], cullBackfaces, setupTriangle))
+						triangles.push_back(setupTriangle);
+				}
+			}
+		});
+
+	// Bands of rows, so every pixel has a single owner
+	m_OcclusionBuffer.Clear();
+	const int bandHeight{ std::max(8, (m_OcclusionBuffer.GetHeight() + 2 * jobSystem.GetNumThreads() - 1) / (2 * jobSystem.GetNumThreads())) };
+	const int numBands{ (m_OcclusionBuffer.GetHeight() + bandHeight - 1) / bandHeight };
+	jobSystem.ParallelFor(0, numBands, [&](int first, int last)
+		{
+			const int firstRow{ first * bandHeight };
+			const int lastRow{ std::min(last * bandHeight, m_OcclusionBuffer.GetHeight()) };
+
+			for (const ArenaVector<OcclusionBuffer::Triangle>& triangles : occluderTriangles)
 			{
-			case PrimitiveTopology::TriangleList:
+				for (const OcclusionBuffer::Triangle& triangle : triangles)
+				{
+					if (triangle.yMax > firstRow && triangle.yMin < lastRow)
+						m_OcclusionBuffer.RasterizeTriangle(triangle, firstRow, lastRow);
+				}
+			}
+		});
+
+	// Occluders are tested too, one can hide behind another but never behind itself
+	jobSystem.ParallelFor(0, numVisible, [&](int first, int last)
+		{
+			for (int visible{ first }; visible < last; ++visible)
+			{
+				if (hasFootprint[visible] && m_OcclusionBuffer.IsOccluded(footprints[visible]))
+					isInstanceVisible[visibleInstances[visible]] = 0;
+			}
+		}, 16);
+
+	for (int visible{}; visible < numVisible; ++visible)
+		frame.statistics.instancesOccluded += isInstanceVisible[visibleInstances[visible]] == 0;
+}
+
+void Renderer::SelectLods(FrameData& frame, ArenaVector<uint8_t>& isInstanceVisible)
+{
+	PROFILE_FUNCTION();
+
+	for (int sceneIndex{}; sceneIndex < static_cast<int>(m_SceneInstances.size()); ++sceneIndex)
+	{
+		uint8_t& lodIndex{ m_InstanceLods[sceneIndex] };
+		if (!frame.settings.isLodSelection)
+		{
+			lodIndex = 0;
+			continue;
+		}
+		if (!isInstanceVisible[sceneIndex])
+			continue;
+
+		const Mesh& mesh{ m_Meshes[m_SceneInstances[sceneIndex].meshIndex] };
+		const Matrix worldMatrix{ m_SpinRotation * mesh.instances[m_SceneInstances[sceneIndex].instanceIndex].worldMatrix };
+		const float radiusScale{ worldMatrix.GetMaxAxisScale() };
+		const float radius{ mesh.bounds.GetExtents().Magnitude() };
+		const float projectedRadius{ m_Camera.GetProjectedRadius(worldMatrix.TransformPoint(mesh.bounds.GetCenter()), radius * radiusScale, frame.height) };
+
+		if (projectedRadius < m_MinInstanceRadius)
+		{
+			isInstanceVisible[sceneIndex] = 0;
+			++frame.statistics.instancesTooSmall;
+			continue;
+		}
+
+		// Level errors are in object space, the scale of the instance cancels out
+		const float pixelsPerUnit{ radius > 0.f ? projectedRadius / radius : 0.f };
+		const int numLods{ static_cast<int>(mesh.lods.size()) };
+		int lod{ std::min(static_cast<int>(lodIndex), numLods - 1) };
+		while (lod > 0 && mesh.lods[lod].error * pixelsPerUnit > m_MaxLodError)
+			--lod;
+		while (lod + 1 < numLods && mesh.lods[lod + 1].error * pixelsPerUnit < m_MaxLodError * m_LodHysteresis)
+			++lod;
+		lodIndex = static_cast<uint8_t>(lod);
+	}
+}
+
+void Renderer::RenderFrontEnd(FrameData& frame)
+{
+	PROFILE_FUNCTION();
+
+	// Snapshot of everything the back end reads, input and key bindings keep changing the members while it runs
+	frame.settings = {
+		m_CurrentLightingMode,
+		m_CurrentToneMapping,
+		m_Exposure,
+		m_Normalz,
+		m_IsDepthBuffer,
+		m_IsOverdrawView,
+		m_CollectTimings,
+		m_CullBackfaces,
+		m_IsOcclusionCulling,
+		m_IsLodSelection,
+		m_IsTemporalUpsampling,
+		m_IsMultisampling,
+		m_ShadingRateSource
+	};
+	frame.zNear = m_Camera.zNear;
+	frame.zFar = m_Camera.zFar;
+	frame.width = std::max(1, static_cast<int>(static_cast<float>(m_Width) * m_ResolutionScale + .5f));
+	frame.height = std::max(1, static_cast<int>(static_cast<float>(m_Height) * m_ResolutionScale + .5f));
+	frame.numTilesX = (frame.width + m_TileSize - 1) / m_TileSize;
+	frame.numTilesY = (frame.height + m_TileSize - 1) / m_TileSize;
+	frame.foveationCenter = m_FoveationCenter;
+	frame.updateCounter = m_UpdateCounter;
+
+	// A new subpixel offset every frame, more phases the more window pixels share a rendered one
+	frame.previousJitter = m_PreviousJitter;
+	frame.jitter = {};
+	if (m_IsTemporalUpsampling)
+	{
+		const float pixelsPerSample{ static_cast<float>(m_Width * m_Height) / static_cast<float>(frame.width * frame.height) };
+		const Vector2 jitter{ TemporalUpsampler::GetJitter(m_JitterIndex++, static_cast<int>(static_cast<float>(m_JitterPhasesPerPixel) * pixelsPerSample + .5f)) };
+		frame.jitter = { jitter.x / static_cast<float>(frame.width), jitter.y / static_cast<float>(frame.height) };
+	}
+	// Screen y runs opposite to NDC y
+	m_Camera.jitter = { 2.f * frame.jitter.x, -2.f * frame.jitter.y };
+	m_Camera.CalculateProjectionMatrix();
+
+	//@START
+	// Stage timings are only measured on request, each lap costs a performance counter read
+	frame.timings = {};
+	uint64_t lapStart{ m_CollectTimings ? SDL_GetPerformanceCounter() : 0 };
+	const double msPerCount{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) };
+
+	auto lap = [&](double FrameTimings::* pStage)
+		{
+			if (!m_CollectTimings)
+				return;
+
+			const uint64_t now{ SDL_GetPerformanceCounter() };
+			frame.timings.*pStage += static_cast<double>(now - lapStart) * msPerCount;
+			lapStart = now;
+		};
+
+	const int numTiles{ frame.numTilesX * frame.numTilesY };
+
+	// The previous frame built in this FrameData is done, its containers go before their memory is reused
+	frame.draws = {};
+	frame.clusters = {};
+	frame.screenVertices = {};
+	frame.previousPositions = {};
+	frame.tileShadingRates = {};
+	frame.binningChunks = {};
+	frame.chunkTriangles = {};
+	frame.tileBins = {};
+	frame.chunkStatistics = {};
+	frame.arena.Reset();
+
+	LinearArena& arena{ frame.arena.GetThreadArena() };
+	frame.draws = ArenaVector<InstanceDraw>{ arena };
+	frame.clusters = ArenaVector<ClusterDraw>{ arena };
+	frame.screenVertices = ArenaVector<Vertex>{ arena };
+	frame.previousPositions = ArenaVector<Vector4>{ arena };
+	frame.binningChunks = ArenaVector<BinningChunk>{ arena };
+
+	// The window's tiles cover the frame's, the back end only sees the rates of the ones the frame uses
+	frame.tileShadingRates = ArenaVector<ShadingRate>{ arena };
+	if (m_ShadingRateSource == ShadingRateSource::Api)
+	{
+		frame.tileShadingRates.reserve(numTiles);
+		for (int tileY{}; tileY < frame.numTilesY; ++tileY)
+			for (int tileX{}; tileX < frame.numTilesX; ++tileX)
+				frame.tileShadingRates.push_back(m_TileShadingRates[tileX + tileY * m_NumTilesX]);
+	}
+
+	PipelineStatistics& statistics{ frame.statistics };
+	statistics = {};
+	const Matrix viewProjectionMatrix{ m_Camera.viewMatrix * m_Camera.projectionMatrix };
+
+	// Instances completely outside the view frustum are dropped here, before any of their vertices are touched
+	const Frustum frustum{ viewProjectionMatrix };
+	UpdateSceneBvh();
+	ArenaVector<uint8_t> isInstanceVisible(m_SceneInstances.size(), uint8_t{ 0 }, arena);
+	m_SceneBvh.Query(frustum, [&isInstanceVisible](int index) { isInstanceVisible[index] = 1; });
+	// Before occlusion culling, which draws the occluders with the level they are drawn with
+	SelectLods(frame, isInstanceVisible);
+	if (frame.settings.isOcclusionCulling)
+		CullOccludedInstances(frame, frustum, viewProjectionMatrix, isInstanceVisible);
+
+	// One draw per visible instance and one cluster per visible meshlet, in scene order
+	// Clusters of a draw are grouped into chunks of up to m_BinningChunkSize triangles for setup and binning
+	int sceneIndex{};
+	int firstVertex{};
+	for (int meshIndex{}; meshIndex < static_cast<int>(m_Meshes.size()); ++meshIndex)
+	{
+		const Mesh& currentMesh{ m_Meshes[meshIndex] };
+
+		for (const MeshInstance& instance : currentMesh.instances)
+		{
+			++statistics.instancesSubmitted;
+			const int lodIndex{ m_InstanceLods[sceneIndex] };
+			if (!isInstanceVisible[sceneIndex++])
 			{
-				vertex0 = currentMesh.vertices_out[currentMesh.indices[triangleIndex * numVertices + 0]];
-				vertex1 = currentMesh.vertices_out[currentMesh.indices[triangleIndex * numVertices + 1]];
-				vertex2 = currentMesh.vertices_out[currentMesh.indices[triangleIndex * numVertices + 2]];
+				++statistics.instancesCulled;
+				continue;
 			}
-			break;
-			case PrimitiveTopology::TriangleStrip:
+
+			const int drawIndex{ static_cast<int>(frame.draws.size()) };
+			const Matrix worldMatrix{ m_SpinRotation * instance.worldMatrix };
+			const Matrix previousWorldViewProjectionMatrix{ frame.settings.isTemporalUpsampling ?
+				m_PreviousSpinRotation * instance.worldMatrix * m_PreviousViewProjectionMatrix : Matrix{} };
+			frame.draws.push_back({ meshIndex, lodIndex, worldMatrix, worldMatrix * viewProjectionMatrix, previousWorldViewProjectionMatrix, instance.tint });
+			const MeshLod& lod{ currentMesh.lods[lodIndex] };
+
+			// Spheres scale with the longest axis, so they still hold every vertex under non-uniform scale
+			const float radiusScale{ worldMatrix.GetMaxAxisScale() };
+
+			for (int meshletIndex{}; meshletIndex < static_cast<int>(lod.meshlets.size()); ++meshletIndex)
 			{
-				vertex0 = currentMesh.vertices_out[currentMesh.indices[triangleIndex + 0]];
-				vertex1 = currentMesh.vertices_out[currentMesh.indices[triangleIndex + 1]];
-				vertex2 = currentMesh.vertices_out[currentMesh.indices[triangleIndex + 2]];
+				const Meshlet& meshlet{ lod.meshlets[meshletIndex] };
+				++statistics.clustersSubmitted;
+				statistics.trianglesSubmitted += meshlet.numTriangles;
 
-				if (triangleIndex % 2 == 1)
-					std::swap(vertex1, vertex2);
+				const Vector3 center{ worldMatrix.TransformPoint(meshlet.center) };
+				const float radius{ meshlet.radius * radiusScale };
 
-				if (vertex0.position == vertex1.position ||
-					vertex0.position == vertex2.position ||
-					vertex1.position == vertex2.position)
+				bool isCulled{ frustum.IsOutside(center, radius) };
+				if (!isCulled && frame.settings.cullBackfaces && meshlet.coneCutoff < 1.f)
+				{
+					// Facing away when the camera looks down every normal in the cone, from anywhere in the sphere
+					const Vector3 axis{ worldMatrix.TransformVector(meshlet.coneAxis).Normalized() };
+					const Vector3 toCenter{ center - m_Camera.origin };
+					isCulled = Vector3::Dot(toCenter, axis) >= meshlet.coneCutoff * toCenter.Magnitude() + radius;
+				}
+
+				if (isCulled)
+				{
+					++statistics.clustersCulled;
+					statistics.trianglesCulled += meshlet.numTriangles;
 					continue;
+				}
+
+				const int clusterIndex{ static_cast<int>(frame.clusters.size()) };
+				frame.clusters.push_back({ drawIndex, meshletIndex, firstVertex });
+				firstVertex += static_cast<int>(meshlet.numVertices);
+				statistics.verticesTransformed += meshlet.numVertices;
+
+				if (frame.binningChunks.empty() || frame.binningChunks.back().drawIndex != drawIndex ||
+					frame.binningChunks.back().numTriangles + static_cast<int>(meshlet.numTriangles) > m_BinningChunkSize)
+					frame.binningChunks.push_back({ drawIndex, clusterIndex, 0, 0 });
+
+				++frame.binningChunks.back().numClusters;
+				frame.binningChunks.back().numTriangles += static_cast<int>(meshlet.numTriangles);
 			}
-			break;
-			default:
-				abort();
+		}
+	}
+
+	// Vertex stage, one range over the vertices of every cluster, so small instances still fill all threads
+	frame.screenVertices.resize(firstVertex);
+	if (frame.settings.isTemporalUpsampling)
+		frame.previousPositions.resize(firstVertex);
+	{
+		PROFILE_SCOPE("Vertex");
+		JobSystem::GetInstance().ParallelFor(0, firstVertex, [this, &frame](int first, int last)
+			{
+				// Clusters are sorted on firstVertex, start at the one holding first
+				const ClusterDraw* pCluster{ std::upper_bound(frame.clusters.data(), frame.clusters.data() + frame.clusters.size(), first,
+					[](int vertexIndex, const ClusterDraw& cluster) { return vertexIndex < cluster.firstVertex; }) - 1 };
+
+				while (first < last)
+				{
+					const InstanceDraw& draw{ frame.draws[pCluster->drawIndex] };
+					const Mesh& mesh{ m_Meshes[draw.meshIndex] };
+					const MeshLod& lod{ mesh.lods[draw.lodIndex] };
+					const Meshlet& meshlet{ lod.meshlets[pCluster->meshletIndex] };
+					const int clusterLast{ std::min(last, pCluster->firstVertex + static_cast<int>(meshlet.numVertices)) };
+
+					const uint32_t* pIndices{ lod.meshletVertices.data() + meshlet.firstVertex + (first - pCluster->firstVertex) };
+					TransformVertices(draw.worldMatrix, draw.worldViewProjectionMatrix, mesh.vertices.data(), pIndices, frame.screenVertices.data() + first,
+						clusterLast - first, frame.width, frame.height);
+					if (frame.settings.isTemporalUpsampling)
+						TransformPreviousPositions(draw.previousWorldViewProjectionMatrix, mesh.vertices.data(), pIndices, frame.previousPositions.data() + first, clusterLast - first);
+
+					first = clusterLast;
+					++pCluster;
+				}
+			}, 256);
+	}
+	lap(&FrameTimings::vertex);
+
+	// Setup and binning, one job per chunk of triangles
+	const int numChunks{ static_cast<int>(frame.binningChunks.size()) };
+	frame.chunkTriangles = ArenaVector<ArenaVector<SetupTriangle>>{ arena };
+	frame.chunkTriangles.resize(numChunks);
+	frame.tileBins = ArenaVector<ArenaVector<int>>{ arena };
+	frame.tileBins.resize(numChunks * numTiles);
+	frame.chunkStatistics = ArenaVector<PipelineStatistics>{ arena };
+	frame.chunkStatistics.resize(numChunks);
+
+	JobSystem::GetInstance().ParallelFor(0, numChunks, [this, &frame](int first, int last)
+		{
+			for (int chunkIndex{ first }; chunkIndex < last; ++chunkIndex)
+				SetupAndBinTriangles(frame, chunkIndex);
+		});
+
+	for (const PipelineStatistics& chunkStatistics : frame.chunkStatistics)
+		statistics += chunkStatistics;
+	lap(&FrameTimings::setup);
+
+	// Where the next frame's motion vectors start from
+	m_PreviousJitter = frame.jitter;
+	m_PreviousSpinRotation = m_SpinRotation;
+	m_PreviousViewProjectionMatrix = viewProjectionMatrix;
+}
+
+void Renderer::RenderBackEnd(FrameData& frame)
+{
+	PROFILE_FUNCTION();
+
+	const RenderSettings& settings{ frame.settings };
+
+	uint64_t lapStart{ settings.collectTimings ? SDL_GetPerformanceCounter() : 0 };
+	const double msPerCount{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) };
+
+	auto lap = [&](double FrameTimings::* pStage)
+		{
+			if (!settings.collectTimings)
+				return;
+
+			const uint64_t now{ SDL_GetPerformanceCounter() };
+			frame.timings.*pStage += static_cast<double>(now - lapStart) * msPerCount;
+			lapStart = now;
+		};
+
+	// Wait for a free BackBuffer, bounds the number of frames queued for present
+	m_pBackBuffer = m_pPresenter ? m_pPresenter->AcquireBackBuffer() : m_pOffscreenBuffer;
+	lap(&FrameTimings::present);
+	m_pBackBufferPixels = static_cast<uint32_t*>(m_pBackBuffer->pixels);
+
+	// Lock BackBuffer
+	SDL_LockSurface(m_pBackBuffer);
+
+	// Allocated on first use, color and depth of every sample of the window
+	if (settings.isMultisampling && !m_pSampleBufferPixels)
+	{
+		const int numSamples{ m_Width * m_Height * m_SamplesPerPixel };
+		m_pSampleBufferPixels = new float[static_cast<size_t>(numSamples) * 3];
+		m_pSampleBufferRed = m_pSampleBufferPixels;
+		m_pSampleBufferGreen = m_pSampleBufferRed + numSamples;
+		m_pSampleBufferBlue = m_pSampleBufferGreen + numSamples;
+		m_SampleDepthBuffer.Initialize(m_Width * m_SamplesPerPixel, m_Height, m_DepthBuffer.GetFormat());
+	}
+
+	// Rates of this frame's tiles, content comes from what the tiles measured last frame
+	switch (settings.shadingRateSource)
+	{
+	case ShadingRateSource::Content:
+		m_ShadingRateMap.SelectFromContent(frame.numTilesX, frame.numTilesY);
+		break;
+	case ShadingRateSource::Foveated:
+		m_ShadingRateMap.SelectFoveated(frame.numTilesX, frame.numTilesY, m_TileSize, frame.width, frame.height, frame.foveationCenter);
+		break;
+	case ShadingRateSource::Api:
+		m_ShadingRateMap.Select(frame.numTilesX, frame.numTilesY, frame.tileShadingRates.data());
+		break;
+	default:
+		m_ShadingRateMap.Fill(frame.numTilesX, frame.numTilesY, ShadingRate::Rate1x1);
+		break;
+	}
+
+	// Color and depth are cleared per tile on first touch, untouched tiles get the clear color at resolve time
+	std::fill(m_TileCleared.begin(), m_TileCleared.end(), uint8_t{ 0 });
+	lap(&FrameTimings::clear);
+
+	JobSystem& jobSystem{ JobSystem::GetInstance() };
+	const int numTiles{ frame.numTilesX * frame.numTilesY };
+
+	// Raster and shade, one job per tile so every pixel has a single owner
+	jobSystem.ParallelFor(0, numTiles, [this, &frame](int first, int last)
+		{
+			for (int tileIndex{ first }; tileIndex < last; ++tileIndex)
+				RasterizeTile(frame, tileIndex);
+		});
+
+	if (settings.collectTimings)
+	{
+		const uint64_t now{ SDL_GetPerformanceCounter() };
+		const double wallMs{ static_cast<double>(now - lapStart) * msPerCount };
+		lapStart = now;
+
+		TileTimings totalTimings{};
+		for (int tileIndex{}; tileIndex < numTiles; ++tileIndex)
+		{
+			totalTimings.raster += m_TileTimings[tileIndex].raster;
+			totalTimings.shade += m_TileTimings[tileIndex].shade;
+		}
+
+		const uint64_t totalTicks{ totalTimings.raster + totalTimings.shade };
+		const double shadeShare{ totalTicks ? static_cast<double>(totalTimings.shade) / static_cast<double>(totalTicks) : 0.0 };
+		frame.timings.raster += wallMs * (1.0 - shadeShare);
+		frame.timings.shade += wallMs * shadeShare;
+	}
+
+	for (int tileIndex{}; tileIndex < numTiles; ++tileIndex)
+		frame.statistics += m_TileStatistics[tileIndex];
+
+	// Resolve HDR color buffer into the back buffer's pixel format, rows split over jobs
+	// The depth and overdraw views already hold [0, 1] values, so they skip exposure and tone mapping
+	const bool isDebugView{ settings.isDepthBuffer || settings.isOverdrawView };
+	const Resolve::ToneMapping toneMapping{ isDebugView ? Resolve::ToneMapping::MaxToOne : settings.toneMapping };
+	const float exposure{ isDebugView ? 1.f : settings.exposure };
+
+	uint32_t clearPixel{};
+	Resolve::PackToPixels(&m_ClearColor.r, &m_ClearColor.g, &m_ClearColor.b, &clearPixel, 1, m_pBackBuffer->format, toneMapping, exposure);
+
+	if (settings.isTemporalUpsampling)
+	{
+		PROFILE_SCOPE("Temporal resolve");
+
+		// Allocated on first use, the history is four planes at the window resolution, twice
+		if (!m_TemporalUpsampler.IsInitialized())
+			m_TemporalUpsampler.Initialize(m_Width, m_Height);
+
+		FillUntouchedTiles(frame);
+		m_TemporalUpsampler.BeginFrame({ m_pColorBufferRed, m_pColorBufferGreen, m_pColorBufferBlue, m_pMotionBufferX, m_pMotionBufferY,
+			frame.width, frame.height, { frame.jitter.x * static_cast<float>(frame.width), frame.jitter.y * static_cast<float>(frame.height) } });
+
+		jobSystem.ParallelFor(0, m_Height, [&](int firstRow, int lastRow)
+			{
+				for (int row{ firstRow }; row < lastRow; ++row)
+				{
+					m_TemporalUpsampler.ResolveRow(row);
+
+					const int offset{ row * m_Width };
+					Resolve::PackToPixels(m_TemporalUpsampler.GetRed() + offset, m_TemporalUpsampler.GetGreen() + offset, m_TemporalUpsampler.GetBlue() + offset,
+						m_pBackBufferPixels + offset, m_Width, m_pBackBuffer->format, toneMapping, exposure);
+				}
+			}, 8);
+		m_TemporalUpsampler.EndFrame();
+	}
+	else if (frame.width == m_Width && frame.height == m_Height)
+	{
+		// Frames in between do not reproject, turning temporal upsampling back on starts a new history
+		m_TemporalUpsampler.Invalidate();
+
+		PROFILE_SCOPE("Resolve");
+		jobSystem.ParallelFor(0, m_Height, [&](int firstRow, int lastRow)
+			{
+				for (int row{ firstRow }; row < lastRow; ++row)
+				{
+					const uint8_t* pTileRowCleared{ m_TileCleared.data() + (row / m_TileSize) * frame.numTilesX };
+
+					for (int tileX{}; tileX < frame.numTilesX; ++tileX)
+					{
+						const int offset{ row * m_Width + tileX * m_TileSize };
+						const int count{ std::min(m_TileSize, m_Width - tileX * m_TileSize) };
+
+						if (pTileRowCleared[tileX])
+							Resolve::PackToPixels(m_pColorBufferRed + offset, m_pColorBufferGreen + offset, m_pColorBufferBlue + offset,
+								m_pBackBufferPixels + offset, count, m_pBackBuffer->format, toneMapping, exposure);
+						else
+							Resolve::StreamFill(m_pBackBufferPixels + offset, count, clearPixel);
+					}
+				}
+			}, 8);
+	}
+	else
+	{
+		m_TemporalUpsampler.Invalidate();
+
+		PROFILE_SCOPE("Upscale");
+
+		// The filter reads across tile borders, so untouched tiles need the clear color in the color buffer first
+		FillUntouchedTiles(frame);
+
+		// Bilinear, the columns are the same for every row so their taps are computed once
+		ArenaVector<Resolve::BilinearTap> taps(m_Width, Resolve::BilinearTap{}, frame.arena.GetThreadArena());
+		Resolve::ComputeBilinearTaps(frame.width, taps.data(), m_Width);
+		const float rowScale{ static_cast<float>(frame.height) / static_cast<float>(m_Height) };
+
+		jobSystem.ParallelFor(0, m_Height, [&](int firstRow, int lastRow)
+			{
+				ArenaVector<float> scratch(m_Width * 3, 0.f, frame.arena.GetThreadArena());
+				float* pRed{ scratch.data() };
+				float* pGreen{ pRed + m_Width };
+				float* pBlue{ pGreen + m_Width };
+
+				for (int row{ firstRow }; row < lastRow; ++row)
+				{
+					const float y{ std::clamp((static_cast<float>(row) + .5f) * rowScale - .5f, 0.f, static_cast<float>(frame.height - 1)) };
+					const int y0{ static_cast<int>(y) };
+					const int offset0{ y0 * frame.width };
+					const int offset1{ std::min(y0 + 1, frame.height - 1) * frame.width };
+
+					Resolve::UpscaleRow(m_pColorBufferRed + offset0, m_pColorBufferGreen + offset0, m_pColorBufferBlue + offset0,
+						m_pColorBufferRed + offset1, m_pColorBufferGreen + offset1, m_pColorBufferBlue + offset1,
+						y - static_cast<float>(y0), taps.data(), pRed, pGreen, pBlue, m_Width);
+					Resolve::PackToPixels(pRed, pGreen, pBlue, m_pBackBufferPixels + row * m_Width, m_Width, m_pBackBuffer->format, toneMapping, exposure);
+				}
+			}, 8);
+	}
+	lap(&FrameTimings::resolve);
+
+	// Update SDL Surface, the present thread blits it to the window while the next frame renders
+	SDL_UnlockSurface(m_pBackBuffer);
+	if (m_pPresenter)
+		m_pPresenter->Present(m_pBackBuffer);
+	lap(&FrameTimings::present);
+
+	if (settings.collectTimings)
+		frame.timings.latency = static_cast<double>(SDL_GetPerformanceCounter() - frame.updateCounter) * msPerCount;
+}
+
+void Renderer::TransformVertices(const Matrix& world, const Matrix& worldViewProjectionMatrix, const Vertex* pVerticesIn, const uint32_t* pIndices,
+	Vertex* pVerticesOut, int numVertices, int width, int height) const
+{
+	// Positions go through the batched transform a chunk at a time, the rest stays per vertex
+	constexpr int chunkSize{ 256 };
+	Vector4 positions[chunkSize];
+	Vector4 transformedPositions[chunkSize];
+
+	for (int chunkStart{}; chunkStart < numVertices; chunkStart += chunkSize)
+	{
+		const int numChunkVertices{ std::min(chunkSize, numVertices - chunkStart) };
+		for (int i{}; i < numChunkVertices; ++i)
+			positions[i] = pVerticesIn[pIndices ? pIndices[chunkStart + i] : chunkStart + i].position;
+
+		worldViewProjectionMatrix.TransformPoints({ positions, static_cast<size_t>(numChunkVertices) }, { transformedPositions, static_cast<size_t>(numChunkVertices) });
+
+		for (int i{}; i < numChunkVertices; ++i)
+		{
+			Vertex ret{ pVerticesIn[pIndices ? pIndices[chunkStart + i] : chunkStart + i] };
+
+			Vector4 vertPos{ transformedPositions[i] };
+
+			// Directions, so without the translation that places the instance
+			const Vector3 normal{ world.TransformVector(ret.normal) };
+			const Vector3 tangent{ world.TransformVector(ret.tangent) };
+
+			// Add perspective
+			vertPos.x /= vertPos.w;
+			vertPos.y /= vertPos.w;
+			vertPos.z /= vertPos.w;
+
+			if (vertPos.x < -1.f || vertPos.x > 1.f ||
+				vertPos.y < -1.f || vertPos.y > 1.f ||
+				vertPos.z < 0.f || vertPos.z > 1.f)
+				ret.valid = false;
+
+			//ndc to screen
+			vertPos.x = ((vertPos.x + 1.f) / 2.f) * static_cast<float>(width);
+			vertPos.y = ((1.f - vertPos.y) / 2.f) * static_cast<float>(height);
+
+			ret.position = vertPos;
+			ret.normal = normal;
+			ret.tangent = tangent;
+			ret.viewDirection = Vector3(vertPos) - m_Camera.origin;
+
+			pVerticesOut[chunkStart + i] = ret;
+		}
+	}
+}
+
+void Renderer::TransformPreviousPositions(const Matrix& previousWorldViewProjectionMatrix, const Vertex* pVerticesIn, const uint32_t* pIndices,
+	Vector4* pPositionsOut, int numVertices) const
+{
+	constexpr int chunkSize{ 256 };
+	Vector4 positions[chunkSize];
+
+	for (int chunkStart{}; chunkStart < numVertices; chunkStart += chunkSize)
+	{
+		const int numChunkVertices{ std::min(chunkSize, numVertices - chunkStart) };
+		for (int i{}; i < numChunkVertices; ++i)
+			positions[i] = pVerticesIn[pIndices ? pIndices[chunkStart + i] : chunkStart + i].position;
+
+		previousWorldViewProjectionMatrix.TransformPoints({ positions, static_cast<size_t>(numChunkVertices) },
+			{ pPositionsOut + chunkStart, static_cast<size_t>(numChunkVertices) });
+	}
+}
+
+void Renderer::SetupAndBinTriangles(FrameData& frame, int chunkIndex)
+{
+	PROFILE_FUNCTION();
+
+	const BinningChunk& chunk{ frame.binningChunks[chunkIndex] };
+	const InstanceDraw& draw{ frame.draws[chunk.drawIndex] };
+	const MeshLod& lod{ m_Meshes[draw.meshIndex].lods[draw.lodIndex] };
+	const bool cullBackfaces{ frame.settings.cullBackfaces };
+	constexpr int numVertices{ 3 };
+	const int numTiles{ frame.numTilesX * frame.numTilesY };
+
+	PipelineStatistics& statistics{ frame.chunkStatistics[chunkIndex] };
+	statistics = {};
+
+	// Allocated from the arena of the thread running this job
+	LinearArena& arena{ frame.arena.GetThreadArena() };
+	ArenaVector<SetupTriangle>& setupTriangles{ frame.chunkTriangles[chunkIndex] };
+	setupTriangles = ArenaVector<SetupTriangle>{ arena };
+	setupTriangles.reserve(chunk.numTriangles);
+
+	ArenaVector<int>* pBins{ frame.tileBins.data() + chunkIndex * numTiles };
+	for (int tileIndex{}; tileIndex < numTiles; ++tileIndex)
+		pBins[tileIndex] = ArenaVector<int>{ arena };
+
+	// Meshlet triangles are lists, strips were converted when the meshlets were built
+	for (int clusterIndex{ chunk.firstCluster }; clusterIndex < chunk.firstCluster + chunk.numClusters; ++clusterIndex)
+	{
+		const ClusterDraw& cluster{ frame.clusters[clusterIndex] };
+		const Meshlet& meshlet{ lod.meshlets[cluster.meshletIndex] };
+		const Vertex* pScreenVertices{ frame.screenVertices.data() + cluster.firstVertex };
+		const Vector4* pPreviousPositions{ frame.settings.isTemporalUpsampling ? frame.previousPositions.data() + cluster.firstVertex : nullptr };
+		const uint8_t* pTriangles{ lod.meshletTriangles.data() + meshlet.firstTriangle * numVertices };
+
+		for (uint32_t triangleIndex{}; triangleIndex < meshlet.numTriangles; triangleIndex++)
+		{
+			Vertex vertex0{ pScreenVertices[pTriangles[triangleIndex * numVertices + 0]] };
+			Vertex vertex1{ pScreenVertices[pTriangles[triangleIndex * numVertices + 1]] };
+			Vertex vertex2{ pScreenVertices[pTriangles[triangleIndex * numVertices + 2]] };
+			Vector4 previous0{};
+			Vector4 previous1{};
+			Vector4 previous2{};
+			if (pPreviousPositions)
+			{
+				previous0 = pPreviousPositions[pTriangles[triangleIndex * numVertices + 0]];
+				previous1 = pPreviousPositions[pTriangles[triangleIndex * numVertices + 1]];
+				previous2 = pPreviousPositions[pTriangles[triangleIndex * numVertices + 2]];
+			}
+
+			// Only judged once all corners are in front of the camera, the others are culled or clipped below anyway
+			if (cullBackfaces && vertex0.valid && vertex1.valid && vertex2.valid)
+			{
+				// Front faces wind the way of Meshlet::coneAxis, which is clockwise with screen y going down
+				const float signedArea{ (vertex1.position.x - vertex0.position.x) * (vertex2.position.y - vertex0.position.y)
+					- (vertex1.position.y - vertex0.position.y) * (vertex2.position.x - vertex0.position.x) };
+				if (signedArea < 0.f)
+				{
+					++statistics.trianglesCulled;
+					continue;
+				}
 			}
 
 			// Ensure counterclockwise winding order
@@ -141,10 +1018,20 @@ void Renderer::Render()
 			{
 				// Swap vertices to enforce counterclockwise winding order
 				std::swap(vertex1, vertex2);
+				std::swap(previous1, previous2);
+			}
+
+			if (!vertex0.valid && !vertex1.valid && !vertex2.valid)
+			{
+				++statistics.trianglesCulled;
+				continue;
 			}
 
 			if (!vertex0.valid || !vertex1.valid || !vertex2.valid)
+			{
+				++statistics.trianglesClipped;
 				continue;
+			}
 
 			// Generalized logic for bounding box
 			int xMin = static_cast<int>(std::min(vertex0.position.x, std::min(vertex1.position.x, vertex2.position.x)));
@@ -152,110 +1039,440 @@ void Renderer::Render()
 			int yMin = static_cast<int>(std::min(vertex0.position.y, std::min(vertex1.position.y, vertex2.position.y)));
 			int yMax = static_cast<int>(std::max(vertex0.position.y, std::max(vertex1.position.y, vertex2.position.y)));
 
-			if (xMin < 0) continue; else xMin -= 1;
-			if (yMin < 0) continue; else yMin -= 1;
+			if (xMin < 0 || yMin < 0 || xMax > frame.width || yMax > frame.height)
+			{
+				++statistics.trianglesClipped;
+				continue;
+			}
+
+			xMin -= 1;
+			yMin -= 1;
+			xMax += 1;
+			yMax += 1;
+
+			// Keep the padded box on screen, the tile clear must cover every pixel the raster loop can write
+			xMin = std::max(xMin, 0);
+			yMin = std::max(yMin, 0);
+			xMax = std::min(xMax, frame.width);
+			yMax = std::min(yMax, frame.height);
+
+			++statistics.trianglesRasterized;
+			statistics.pixelsTested += static_cast<uint64_t>(xMax - xMin) * static_cast<uint64_t>(yMax - yMin);
+
+			const int setupIndex{ static_cast<int>(setupTriangles.size()) };
+			setupTriangles.push_back({ vertex0, vertex1, vertex2, previous0, previous1, previous2, xMin, yMin, xMax, yMax });
+
+			const int tileXMax{ (xMax - 1) / m_TileSize };
+			const int tileYMax{ (yMax - 1) / m_TileSize };
+			for (int tileY{ yMin / m_TileSize }; tileY <= tileYMax; ++tileY)
+				for (int tileX{ xMin / m_TileSize }; tileX <= tileXMax; ++tileX)
+					pBins[tileX + tileY * frame.numTilesX].push_back(setupIndex);
+		}
+	}
+}
+
+void Renderer::RasterizeTile(const FrameData& frame, int tileIndex)
+{
+	PROFILE_FUNCTION();
+
+	const RenderSettings& settings{ frame.settings };
+	const int numTiles{ frame.numTilesX * frame.numTilesY };
+	const int numChunks{ static_cast<int>(frame.binningChunks.size()) };
+
+	const int tileXMin{ (tileIndex % frame.numTilesX) * m_TileSize };
+	const int tileYMin{ (tileIndex / frame.numTilesX) * m_TileSize };
+	const int tileXMax{ std::min(tileXMin + m_TileSize, frame.width) };
+	const int tileYMax{ std::min(tileYMin + m_TileSize, frame.height) };
+
+	PipelineStatistics& statistics{ m_TileStatistics[tileIndex] };
+	statistics = {};
+	TileTimings& timings{ m_TileTimings[tileIndex] };
+	timings = {};
+	uint64_t lapStart{ settings.collectTimings ? SDL_GetPerformanceCounter() : 0 };
+
+	auto lap = [&](uint64_t TileTimings::* pStage)
+		{
+			if (!settings.collectTimings)
+				return;
+
+			const uint64_t now{ SDL_GetPerformanceCounter() };
+			timings.*pStage += now - lapStart;
+			lapStart = now;
+		};
+
+	// Every ShadePixel call samples diffuse, specular and gloss, plus the normal map when enabled
+	const uint64_t textureFetchesPerShade{ settings.useNormals ? 4u : 3u };
+	const float invDepthRange{ 1.f / (frame.zFar - frame.zNear) };
+	const float invWidth{ 1.f / static_cast<float>(frame.width) };
+	const float invHeight{ 1.f / static_cast<float>(frame.height) };
+	ColorRGB finalColor{};
+
+	// Reused by every tile this thread rasterizes
+	thread_local std::vector<Fragment> fragments{};
+	// Block of every fragment and the blocks of a tile at the finest coarse rate, only used by tiles at a coarse shading rate
+	thread_local std::vector<int> fragmentBlocks{};
+	thread_local std::vector<ShadingBlock> shadingBlocks(m_TileSize * m_TileSize / 4);
+
+	// Last frame's clip position interpolated like any attribute, perspective correct, then projected
+	auto writeMotion = [&](int index, const Vector2& point, const SetupTriangle& triangle, const Sample& sample)
+		{
+			const Vector3& weight{ sample.weight };
+			const Vector4 previous{ (triangle.previous0 * (weight.x / triangle.vertex0.position.w) + triangle.previous1 * (weight.y / triangle.vertex1.position.w)
+				+ triangle.previous2 * (weight.z / triangle.vertex2.position.w)) * sample.depth };
+
+			Vector2 motion{};
+			if (previous.w > 0.f)
+			{
+				const Vector2 previousUv{ Vector2{ previous.x / previous.w * .5f + .5f, .5f - previous.y / previous.w * .5f } - frame.previousJitter };
+				const Vector2 uv{ Vector2{ point.x * invWidth, point.y * invHeight } - frame.jitter };
+				motion = uv - previousUv;
+			}
+			m_pMotionBufferX[index] = motion.x;
+			m_pMotionBufferY[index] = motion.y;
+		};
+
+	// Chunks in order, then triangles in order within a chunk, is submission order
+	for (int chunkIndex{}; chunkIndex < numChunks; ++chunkIndex)
+	{
+		const ArenaVector<SetupTriangle>& setupTriangles{ frame.chunkTriangles[chunkIndex] };
+		const ColorRGB& tint{ frame.draws[frame.binningChunks[chunkIndex].drawIndex].tint };
+		for (const int setupIndex : frame.tileBins[chunkIndex * numTiles + tileIndex])
+		{
+			const SetupTriangle& triangle{ setupTriangles[setupIndex] };
+
+			if (!m_TileCleared[tileIndex])
+				ClearTile(frame, tileIndex);
 
-			if (xMax > m_Width) continue; else xMax += 1;
-			if (yMax > m_Height) continue; else yMax += 1;
+			// Part of the bounding box inside this tile
+			const int xMin{ std::max(triangle.xMin, tileXMin) };
+			const int yMin{ std::max(triangle.yMin, tileYMin) };
+			const int xMax{ std::min(triangle.xMax, tileXMax) };
+			const int yMax{ std::min(triangle.yMax, tileYMax) };
 
 			// RENDER LOGIC
-			for (int px{ xMin }; px < xMax; ++px)
+			// Coverage and depth first, the fragments that pass are shaded as one batch below
+			fragments.clear();
+			if (settings.isMultisampling)
 			{
-				if (px < 0) continue;
+				// Trongle's edge functions are linear, so at a sample they are their value at the pixel center plus a fixed step
+				// Edge k is the one across from vertex k, its steps along x and y come from that edge's direction
+				const Vector4& position0{ triangle.vertex0.position };
+				const Vector4& position1{ triangle.vertex1.position };
+				const Vector4& position2{ triangle.vertex2.position };
+				const Vector3 stepX{ position2.y - position1.y, position0.y - position2.y, position1.y - position0.y };
+				const Vector3 stepY{ position1.x - position2.x, position2.x - position0.x, position0.x - position1.x };
+				Vector3 sampleSteps[m_SamplesPerPixel]{};
+				for (int sampleIndex{}; sampleIndex < m_SamplesPerPixel; ++sampleIndex)
+					sampleSteps[sampleIndex] = stepX * m_SampleOffsets[sampleIndex].x + stepY * m_SampleOffsets[sampleIndex].y;
+
+				// The weights add up to twice the signed area anywhere, negative inside and zero for a line, which covers nothing
+				// A sample's depth is the perspective correct blend of the w's
+				const float totalWeight{ HitTest::CrossZ(position2, position1, position0) };
+				if (totalWeight >= 0.f)
+					continue;
+				const Vector3 invWeightDepths{ 1.f / (totalWeight * position0.w), 1.f / (totalWeight * position1.w), 1.f / (totalWeight * position2.w) };
 
-				for (int py{ yMin }; py < yMax; ++py)
+				// Stepped from the first pixel center of the box, close by so the steps stay small
+				const Vector3 corner{ xMin + 0.5f, yMin + 0.5f, 0.f };
+				const Vector3 cornerWeights{ HitTest::CrossZ(position2, position1, corner), HitTest::CrossZ(position0, position2, corner),
+					HitTest::CrossZ(position1, position0, corner) };
+
+				for (int px{ xMin }; px < xMax; ++px)
 				{
-					if (py < 0) continue;
+					const Vector3 columnWeights{ cornerWeights + stepX * static_cast<float>(px - xMin) };
+					for (int py{ yMin }; py < yMax; ++py)
+					{
+						const Vector3 centerWeights{ columnWeights + stepY * static_cast<float>(py - yMin) };
+
+						const int pixelIndex{ px + (py * frame.width) };
+						uint8_t coverage{};
+						Vector3 coveredWeights{};
+						Vector2 coveredOffsets{};
+						int numCovered{};
+						for (int sampleIndex{}; sampleIndex < m_SamplesPerPixel; ++sampleIndex)
+						{
+							const Vector3 weights{ centerWeights + sampleSteps[sampleIndex] };
+							if (weights.x > 0.f || weights.y > 0.f || weights.z > 0.f)
+								continue;
+
+							const float depth{ 1.f / (weights.x * invWeightDepths.x + weights.y * invWeightDepths.y + weights.z * invWeightDepths.z) };
+							if (!m_SampleDepthBuffer.TestAndWrite(pixelIndex * m_SamplesPerPixel + sampleIndex, (depth - frame.zNear) * invDepthRange))
+								continue;
+
+							coverage |= static_cast<uint8_t>(1u << sampleIndex);
+							coveredWeights += weights;
+							coveredOffsets += m_SampleOffsets[sampleIndex];
+							++numCovered;
+						}
 
-					Vector3 point{ px + 0.5f, py + 0.5f, 0.f };
+						if (!coverage)
+							continue;
 
-					std::optional<Sample> sample = HitTest::Trongle(point, vertex0, vertex1, vertex2);
+						// Shaded once, at the centroid of the samples that passed, which is the pixel center when they all did
+						// Interpolate normalizes the weights, so their sum works as well as their average
+						const Sample sample{ HitTest::Interpolate(coveredWeights, triangle.vertex0, triangle.vertex1, triangle.vertex2) };
+						fragments.push_back({ pixelIndex, (sample.depth - frame.zNear) * invDepthRange, sample, coverage });
 
-					if (!sample.has_value())
-						continue;
+						if (settings.isTemporalUpsampling)
+							writeMotion(pixelIndex, Vector2{ px + .5f, py + .5f } + coveredOffsets / static_cast<float>(numCovered), triangle, sample);
+					}
+				}
+			}
+			else
+			{
+				for (int px{ xMin }; px < xMax; ++px)
+				{
+					for (int py{ yMin }; py < yMax; ++py)
+					{
+						Vector3 point{ px + 0.5f, py + 0.5f, 0.f };
 
-					const int depthBufferIndex{ px + (py * m_Width) };
+						std::optional<Sample> sample = HitTest::Trongle(point, triangle.vertex0, triangle.vertex1, triangle.vertex2);
 
-					float min{ .985f };
-					float max{ 1.f };
-					// Depth buffer calculation
-					float depthBuffer = (sample.value().depth - min) / (max - min);
+						if (!sample.has_value())
+							continue;
 
-					// Depth buffer update
-					if (depthBuffer < m_pDepthBufferPixels[depthBufferIndex])
+						const int depthBufferIndex{ px + (py * frame.width) };
+
+						// Depth buffer calculation, sample depth is the interpolated view space depth
+						const float depthBuffer{ (sample.value().depth - frame.zNear) * invDepthRange };
+
+						// Depth buffer update
+						if (!m_DepthBuffer.TestAndWrite(depthBufferIndex, depthBuffer))
+							continue;
+
+						fragments.push_back({ depthBufferIndex, depthBuffer, sample.value() });
+
+						if (settings.isTemporalUpsampling)
+							writeMotion(depthBufferIndex, { point.x, point.y }, triangle, sample.value());
+					}
+				}
+			}
+			statistics.pixelsDepthPassed += fragments.size();
+			lap(&TileTimings::raster);
+
+			if (settings.isOverdrawView)
+			{
+				// Colored once all geometry of the tile is done, see below
+				for (const Fragment& fragment : fragments)
+					++m_ShadeCounts[fragment.index];
+
+				lap(&TileTimings::shade);
+				continue;
+			}
+
+			// Up to the end of the triangle, so traces tell raster and shade apart
+			PROFILE_SCOPE("ShadeBatch");
+
+			// Coarse tiles shade one fragment per block of pixels and hand its color to the others in the block
+			// The fragment nearest the block center is the one shaded, the center itself can be outside the triangle
+			const int blockSize{ settings.isDepthBuffer ? 1 : ShadingRateMap::GetBlockSize(m_ShadingRateMap.GetRate(tileIndex)) };
+			if (blockSize > 1)
+			{
+				const int blocksPerRow{ m_TileSize / blockSize };
+				fragmentBlocks.resize(fragments.size());
+				for (int fragmentIndex{}; fragmentIndex < static_cast<int>(fragments.size()); ++fragmentIndex)
+				{
+					const int x{ fragments[fragmentIndex].index % frame.width - tileXMin };
+					const int y{ fragments[fragmentIndex].index / frame.width - tileYMin };
+					// Twice the distance to the block center, along x plus along y
+					const int distance{ std::abs(2 * (x % blockSize) + 1 - blockSize) + std::abs(2 * (y % blockSize) + 1 - blockSize) };
+
+					const int blockIndex{ x / blockSize + (y / blockSize) * blocksPerRow };
+					fragmentBlocks[fragmentIndex] = blockIndex;
+					ShadingBlock& block{ shadingBlocks[blockIndex] };
+					if (block.fragmentIndex < 0 || distance < block.distance)
 					{
-						m_pDepthBufferPixels[depthBufferIndex] = depthBuffer;
+						block.fragmentIndex = fragmentIndex;
+						block.distance = distance;
+					}
+				}
+			}
 
-						// Update Color in Buffer
-						if (m_IsDepthBuffer)
-						{
-							// Normalize depth value for visualization
-							float normalizedDepth = (depthBuffer - 0.985f) / (1.0f - 0.985f);
+			uint64_t numShaded{};
+			for (int fragmentIndex{}; fragmentIndex < static_cast<int>(fragments.size()); ++fragmentIndex)
+			{
+				const Fragment& fragment{ fragments[fragmentIndex] };
 
-							// Map normalized depth to greyscale color
-							finalColor = ColorRGB{ normalizedDepth, normalizedDepth, normalizedDepth };
-							finalColor.MaxToOne(); // Ensure values are in the valid color range
-						}
-						else
-						{
-							finalColor = ShadePixel(sample.value());
-						}
+				// Update Color in Buffer
+				if (settings.isDepthBuffer)
+				{
+					// Map linear depth to greyscale color
+					finalColor = ColorRGB{ fragment.depth, fragment.depth, fragment.depth };
+				}
+				else if (blockSize > 1)
+				{
+					ShadingBlock& block{ shadingBlocks[fragmentBlocks[fragmentIndex]] };
+					if (!block.isShaded)
+					{
+						block.color = ShadePixel(fragments[block.fragmentIndex].sample, tint, settings);
+						block.isShaded = true;
+						++numShaded;
+					}
+					finalColor = block.color;
+				}
+				else
+				{
+					finalColor = ShadePixel(fragment.sample, tint, settings);
+					++numShaded;
+				}
 
-						finalColor.MaxToOne();
+				// Stored as HDR, tone mapping happens once per pixel in the resolve pass
+				if (settings.isMultisampling)
+				{
+					const int firstSample{ fragment.index * m_SamplesPerPixel };
+					for (int sampleIndex{}; sampleIndex < m_SamplesPerPixel; ++sampleIndex)
+					{
+						if (!(fragment.coverage & (1u << sampleIndex)))
+							continue;
 
-						m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-							static_cast<uint8_t>(finalColor.r * 255),
-							static_cast<uint8_t>(finalColor.g * 255),
-							static_cast<uint8_t>(finalColor.b * 255));
+						m_pSampleBufferRed[firstSample + sampleIndex] = finalColor.r;
+						m_pSampleBufferGreen[firstSample + sampleIndex] = finalColor.g;
+						m_pSampleBufferBlue[firstSample + sampleIndex] = finalColor.b;
 					}
 				}
+				else
+				{
+					m_pColorBufferRed[fragment.index] = finalColor.r;
+					m_pColorBufferGreen[fragment.index] = finalColor.g;
+					m_pColorBufferBlue[fragment.index] = finalColor.b;
+				}
 			}
+			statistics.pixelsShaded += numShaded;
+			statistics.textureFetches += numShaded * textureFetchesPerShade;
+
+			// Ready for the next triangle
+			if (blockSize > 1)
+			{
+				for (const int blockIndex : fragmentBlocks)
+					shadingBlocks[blockIndex] = {};
+			}
+			lap(&TileTimings::shade);
 		}
 	}
-	//@END
-	// Update SDL Surface
-	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, nullptr, m_pFrontBuffer, nullptr);
-	SDL_UpdateWindowSurface(m_pWindow);
+
+	// While the samples are still in cache, counted as shading
+	if (settings.isMultisampling && m_TileCleared[tileIndex])
+	{
+		ResolveTileSamples(frame, tileIndex);
+		lap(&TileTimings::shade);
+	}
+
+	// What the next frame picks its rates from, the debug views have no shading to measure
+	if (settings.shadingRateSource == ShadingRateSource::Content && !settings.isDepthBuffer && !settings.isOverdrawView && m_TileCleared[tileIndex])
+	{
+		const int offset{ tileXMin + tileYMin * frame.width };
+		m_ShadingRateMap.MeasureTile(tileIndex, m_pColorBufferRed + offset, m_pColorBufferGreen + offset, m_pColorBufferBlue + offset, frame.width,
+			tileXMax - tileXMin, tileYMax - tileYMin);
+		lap(&TileTimings::shade);
+	}
+
+	if (settings.isOverdrawView && m_TileCleared[tileIndex])
+	{
+		for (int y{ tileYMin }; y < tileYMax; ++y)
+		{
+			for (int index{ tileXMin + y * frame.width }; index < tileXMax + y * frame.width; ++index)
+			{
+				if (!m_ShadeCounts[index])
+					continue;
+
+				const ColorRGB heatColor{ OverdrawColor(m_ShadeCounts[index]) };
+				m_pColorBufferRed[index] = heatColor.r;
+				m_pColorBufferGreen[index] = heatColor.g;
+				m_pColorBufferBlue[index] = heatColor.b;
+			}
+		}
+		lap(&TileTimings::shade);
+	}
 }
 
-void Renderer::VertexTransformationFunction(const Matrix& world, const Matrix& worldViewProjectionMatrix, const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const
+void Renderer::ClearTile(const FrameData& frame, int tileIndex)
 {
-	vertices_out.clear();
+	m_TileCleared[tileIndex] = 1;
+
+	// Regular stores on purpose, the raster loop reads these pixels right after
+	const int x0{ (tileIndex % frame.numTilesX) * m_TileSize };
+	const int count{ std::min(m_TileSize, frame.width - x0) };
+	const int y0{ (tileIndex / frame.numTilesX) * m_TileSize };
+	const int y1{ std::min(y0 + m_TileSize, frame.height) };
+	const bool isOverdrawView{ frame.settings.isOverdrawView };
 
-	for (const Vertex& vert : vertices_in)
+	for (int y{ y0 }; y < y1; ++y)
 	{
-		Vertex ret{ vert };
+		const int offset{ x0 + y * frame.width };
+		if (frame.settings.isMultisampling)
+		{
+			// The color buffer is written from the samples once the tile is done
+			const int sampleOffset{ offset * m_SamplesPerPixel };
+			const int sampleCount{ count * m_SamplesPerPixel };
+			m_SampleDepthBuffer.Clear(sampleOffset, sampleCount);
+			Resolve::Fill(m_pSampleBufferRed + sampleOffset, m_pSampleBufferGreen + sampleOffset, m_pSampleBufferBlue + sampleOffset, sampleCount,
+				m_ClearColor.r, m_ClearColor.g, m_ClearColor.b);
+		}
+		else
+		{
+			m_DepthBuffer.Clear(offset, count);
+			Resolve::Fill(m_pColorBufferRed + offset, m_pColorBufferGreen + offset, m_pColorBufferBlue + offset, count,
+				m_ClearColor.r, m_ClearColor.g, m_ClearColor.b);
+		}
 
-		Vector4 vertPos{ worldViewProjectionMatrix.TransformPoint({ret.position, 1}) };
+		if (isOverdrawView)
+			std::fill(m_ShadeCounts.begin() + offset, m_ShadeCounts.begin() + offset + count, uint16_t{ 0 });
+		if (frame.settings.isTemporalUpsampling)
+		{
+			std::fill(m_pMotionBufferX + offset, m_pMotionBufferX + offset + count, 0.f);
+			std::fill(m_pMotionBufferY + offset, m_pMotionBufferY + offset + count, 0.f);
+		}
+	}
+}
 
-		const Vector3 normal{ world.TransformPoint(ret.normal) };
-		const Vector3 tangent{ world.TransformPoint(ret.tangent) };
+void Renderer::ResolveTileSamples(const FrameData& frame, int tileIndex)
+{
+	const int x0{ (tileIndex % frame.numTilesX) * m_TileSize };
+	const int count{ std::min(m_TileSize, frame.width - x0) };
+	const int y0{ (tileIndex / frame.numTilesX) * m_TileSize };
+	const int y1{ std::min(y0 + m_TileSize, frame.height) };
 
-		// Add perspective
-		vertPos.x /= vertPos.w;
-		vertPos.y /= vertPos.w;
-		vertPos.z /= vertPos.w;
+	for (int y{ y0 }; y < y1; ++y)
+	{
+		const int offset{ x0 + y * frame.width };
+		const int sampleOffset{ offset * m_SamplesPerPixel };
+		Resolve::AverageSamples(m_pSampleBufferRed + sampleOffset, m_pSampleBufferGreen + sampleOffset, m_pSampleBufferBlue + sampleOffset, m_SamplesPerPixel,
+			m_pColorBufferRed + offset, m_pColorBufferGreen + offset, m_pColorBufferBlue + offset, count);
+	}
+}
 
-		if (vertPos.x < -1.f || vertPos.x > 1.f ||
-			vertPos.y < -1.f || vertPos.y > 1.f ||
-			vertPos.z < 0.f || vertPos.z > 1.f)
-			ret.valid = false;
+void Renderer::FillUntouchedTiles(const FrameData& frame)
+{
+	const int numTiles{ frame.numTilesX * frame.numTilesY };
+	JobSystem::GetInstance().ParallelFor(0, numTiles, [&](int first, int last)
+		{
+			for (int tileIndex{ first }; tileIndex < last; ++tileIndex)
+			{
+				if (m_TileCleared[tileIndex])
+					continue;
 
-		//ndc to screen
-		vertPos.x = ((vertPos.x + 1.f) / 2.f) * static_cast<float>(m_Width);
-		vertPos.y = ((1.f - vertPos.y) / 2.f) * static_cast<float>(m_Height);
+				const int x0{ (tileIndex % frame.numTilesX) * m_TileSize };
+				const int count{ std::min(m_TileSize, frame.width - x0) };
+				const int y0{ (tileIndex / frame.numTilesX) * m_TileSize };
+				const int y1{ std::min(y0 + m_TileSize, frame.height) };
 
-		ret.position = vertPos;
-		ret.normal = normal;
-		ret.tangent = tangent;
-		ret.viewDirection = Vector3(vertPos) - m_Camera.origin;
+				for (int y{ y0 }; y < y1; ++y)
+				{
+					const int offset{ x0 + y * frame.width };
+					Resolve::Fill(m_pColorBufferRed + offset, m_pColorBufferGreen + offset, m_pColorBufferBlue + offset, count,
+						m_ClearColor.r, m_ClearColor.g, m_ClearColor.b);
 
-		vertices_out.push_back(ret);
-	}
+					if (frame.settings.isTemporalUpsampling)
+					{
+						std::fill(m_pMotionBufferX + offset, m_pMotionBufferX + offset + count, 0.f);
+						std::fill(m_pMotionBufferY + offset, m_pMotionBufferY + offset + count, 0.f);
+					}
+				}
+			}
+		});
 }
 
-ColorRGB Renderer::ShadePixel(const Sample& sample) const
+ColorRGB Renderer::ShadePixel(const Sample& sample, const ColorRGB& tint, const RenderSettings& settings) const
 {
 	const Vector3 lightDirection{ .577f, -.577f, .577f };
 	constexpr float lightIntensity{ 7.f };
@@ -265,7 +1482,7 @@ ColorRGB Renderer::ShadePixel(const Sample& sample) const
 
 	Vector3 normal = sample.normal;
 
-	if (m_Normalz)
+	if (settings.useNormals)
 	{
 		const ColorRGB normalSampleColor{ m_VehicleNormalPtr->Sample(sample.uv) };
 		const Vector4 normalSample{
@@ -287,7 +1504,7 @@ ColorRGB Renderer::ShadePixel(const Sample& sample) const
 
 	const float cosAngle{ std::max(0.f,  Vector3::Dot(normal, lightDirection)) };
 
-	const ColorRGB diffuseSample{ m_VehicleDiffusePtr->Sample(sample.uv) };
+	const ColorRGB diffuseSample{ m_VehicleDiffusePtr->Sample(sample.uv) * tint };
 	const ColorRGB lambert{ diffuseSample * lightIntensity / PI };
 
 	float specularReflectance{ 1.f };
@@ -298,7 +1515,7 @@ ColorRGB Renderer::ShadePixel(const Sample& sample) const
 
 	const ColorRGB specular = specularReflectance * powf(std::max(0.f, cosAngle), shininess) * colors::White;
 
-	switch (m_CurrentLightingMode)
+	switch (settings.lightingMode)
 	{
 	case LightingMode::ObservedArea:
 	{
@@ -326,9 +1543,21 @@ ColorRGB Renderer::ShadePixel(const Sample& sample) const
 	return color;
 }
 
-bool Renderer::SaveBufferToImage() const
+bool Renderer::SaveBufferToImage()
+{
+	return SaveBufferToImage("Rasterizer_ColorBuffer.bmp");
+}
+
+bool Renderer::SaveBufferToImage(const std::string& path)
 {
-	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+	Flush();
+
+	// SDL_SaveBMP and the blit of the present thread both rewrite the blit map of the surface
+	if (m_pPresenter)
+		m_pPresenter->WaitForPresent();
+
+	SDL_Surface* pBuffer{ m_pPresenter ? m_pPresenter->GetLastBackBuffer() : m_pOffscreenBuffer };
+	return SDL_SaveBMP(pBuffer, path.c_str());
 }
 
 void Renderer::ToggleDepthBuffer()
@@ -336,11 +1565,51 @@ void Renderer::ToggleDepthBuffer()
 	m_IsDepthBuffer = !m_IsDepthBuffer;
 }
 
+void Renderer::ToggleOverdrawView()
+{
+	m_IsOverdrawView = !m_IsOverdrawView;
+}
+
+void Renderer::CycleDepthFormat()
+{
+	// The back end in flight still tests against the current buffer
+	Flush();
+	const DepthFormat nextFormat{ DepthFormat((int(m_DepthBuffer.GetFormat()) + 1) % int(DepthFormat::enumSize)) };
+	m_DepthBuffer.Initialize(m_Width, m_Height, nextFormat);
+	if (m_pSampleBufferPixels)
+		m_SampleDepthBuffer.Initialize(m_Width * m_SamplesPerPixel, m_Height, nextFormat);
+}
+
+void Renderer::SetCollectTimings(bool collectTimings)
+{
+	m_CollectTimings = collectTimings;
+}
+
+void Renderer::SetInputEnabled(bool isInputEnabled)
+{
+	m_IsInputEnabled = isInputEnabled;
+}
+
 void Renderer::ToggleRotation()
 {
 	m_ShouldSpin = !m_ShouldSpin;
 }
 
+void Renderer::ToggleBackfaceCulling()
+{
+	m_CullBackfaces = !m_CullBackfaces;
+}
+
+void Renderer::ToggleOcclusionCulling()
+{
+	m_IsOcclusionCulling = !m_IsOcclusionCulling;
+}
+
+void Renderer::ToggleLodSelection()
+{
+	m_IsLodSelection = !m_IsLodSelection;
+}
+
 void Renderer::ToggleUseNormals()
 {
 	m_Normalz = !m_Normalz;
@@ -350,3 +1619,110 @@ void Renderer::CycleLightingMode()
 {
 	m_CurrentLightingMode = LightingMode((int(m_CurrentLightingMode) + 1) % int(LightingMode::enumSize));
 }
+
+void Renderer::SetLightingMode(LightingMode lightingMode)
+{
+	m_CurrentLightingMode = lightingMode;
+}
+
+void Renderer::SetUseNormals(bool useNormals)
+{
+	m_Normalz = useNormals;
+}
+
+void Renderer::SetDepthBufferView(bool isDepthBuffer)
+{
+	m_IsDepthBuffer = isDepthBuffer;
+}
+
+void Renderer::SetRotation(bool shouldSpin)
+{
+	m_ShouldSpin = shouldSpin;
+}
+
+void Renderer::SetBackfaceCulling(bool cullBackfaces)
+{
+	m_CullBackfaces = cullBackfaces;
+}
+
+void Renderer::SetOcclusionCulling(bool isOcclusionCulling)
+{
+	m_IsOcclusionCulling = isOcclusionCulling;
+}
+
+void Renderer::SetLodSelection(bool isLodSelection)
+{
+	m_IsLodSelection = isLodSelection;
+}
+
+void Renderer::SetFrameTimeTarget(float milliseconds)
+{
+	m_FrameTimeTarget = std::max(milliseconds, 0.f);
+	m_FramesAtResolution = 0;
+}
+
+void Renderer::SetResolutionScale(float scale)
+{
+	m_ResolutionScale = std::clamp(scale, m_MinResolutionScale, 1.f);
+	m_FramesAtResolution = 0;
+}
+
+void Renderer::ToggleTemporalUpsampling()
+{
+	m_IsTemporalUpsampling = !m_IsTemporalUpsampling;
+}
+
+void Renderer::SetTemporalUpsampling(bool isTemporalUpsampling)
+{
+	m_IsTemporalUpsampling = isTemporalUpsampling;
+}
+
+void Renderer::ToggleMultisampling()
+{
+	m_IsMultisampling = !m_IsMultisampling;
+}
+
+void Renderer::SetMultisampling(bool isMultisampling)
+{
+	m_IsMultisampling = isMultisampling;
+}
+
+void Renderer::CycleShadingRateSource()
+{
+	m_ShadingRateSource = ShadingRateSource((int(m_ShadingRateSource) + 1) % int(ShadingRateSource::enumSize));
+}
+
+void Renderer::SetShadingRateSource(ShadingRateSource source)
+{
+	m_ShadingRateSource = source;
+}
+
+void Renderer::SetFoveationCenter(const Vector2& center)
+{
+	m_FoveationCenter = center;
+}
+
+void Renderer::SetTileShadingRate(int tileX, int tileY, ShadingRate rate)
+{
+	if (tileX < 0 || tileY < 0 || tileX >= m_NumTilesX || tileY >= m_NumTilesY)
+		return;
+
+	m_TileShadingRates[tileX + tileY * m_NumTilesX] = rate;
+}
+
+void Renderer::SetInstances(std::vector<MeshInstance> instances)
+{
+	// The back end only reads the draws the front end copied out of these
+	m_Meshes[0].instances = std::move(instances);
+	m_IsSceneBvhStale = true;
+}
+
+void Renderer::CycleToneMapping()
+{
+	m_CurrentToneMapping = Resolve::ToneMapping((int(m_CurrentToneMapping) + 1) % int(Resolve::ToneMapping::enumSize));
+}
+
+void Renderer::ChangeExposure(float stops)
+{
+	m_Exposure = std::clamp(m_Exposure * powf(2.f, stops), 1.f / 64.f, 64.f);
+}
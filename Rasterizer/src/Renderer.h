@@ -1,10 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
+#include "Bvh.h"
 #include "Camera.h"
 #include "DataTypes.h"
+#include "DepthBuffer.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "Resolve.h"
+#include "ShadingRateMap.h"
+#include "TemporalUpsampler.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -16,75 +25,519 @@ namespace dae
 	struct Vertex;
 	class Timer;
 	class Scene;
+	class Presenter;
+
+	// What to load and where to look from, defaults to the vehicle scene
+	struct SceneDescription
+	{
+		std::string meshPath{ "Resources/vehicle.obj" };
+		std::string diffusePath{ "Resources/vehicle_diffuse.png" };
+		std::string glossPath{ "Resources/vehicle_gloss.png" };
+		std::string normalPath{ "Resources/vehicle_normal.png" };
+		std::string specularPath{ "Resources/vehicle_specular.png" };
+
+		Vector3 cameraOrigin{ 0.f, 5.f, -64.f };
+		float fovAngle{ 45.f };
+
+		// The mesh is drawn once per instance, see SetInstances
+		std::vector<MeshInstance> instances{ MeshInstance{} };
+	};
+
+	// Milliseconds spent per pipeline stage during the last Render call
+	// Tiles rasterize and shade in the same job, their wall time is split over raster and shade by the time the tile jobs spent on each
+	struct FrameTimings
+	{
+		double clear{};
+		double vertex{};
+		double setup{};
+		double raster{};
+		double shade{};
+		double resolve{};
+		// Time the render thread waited on or handed off to the present thread
+		double present{};
+
+		// Not a stage, time from the Update the frame was built from until it was handed to present
+		double latency{};
+	};
+
+	// Work done during the last Render call, modeled on GPU pipeline statistics queries
+	// Every thread counts into its own copy, the copies are merged with += once their work is done
+	struct PipelineStatistics
+	{
+		uint64_t instancesSubmitted{};
+		// Completely outside the view frustum, behind the occluders or too small to see, rejected before any vertex work
+		uint64_t instancesCulled{};
+		// The part of instancesCulled the occlusion buffer rejected
+		uint64_t instancesOccluded{};
+		// The part of instancesCulled that would cover less than a pixel or so
+		uint64_t instancesTooSmall{};
+		uint64_t clustersSubmitted{};
+		// Completely outside the view frustum, or facing away when backface culling is on, before any vertex work
+		uint64_t clustersCulled{};
+		uint64_t verticesTransformed{};
+		uint64_t trianglesSubmitted{};
+		// In a culled cluster, completely outside the view frustum or facing away when backface culling is on
+		uint64_t trianglesCulled{};
+		// Partially outside the view frustum or screen, dropped since there is no clipper
+		uint64_t trianglesClipped{};
+		uint64_t trianglesRasterized{};
+		uint64_t pixelsTested{};
+		uint64_t pixelsDepthPassed{};
+		uint64_t pixelsShaded{};
+		uint64_t textureFetches{};
+
+		PipelineStatistics& operator+=(const PipelineStatistics& other)
+		{
+			instancesSubmitted += other.instancesSubmitted;
+			instancesCulled += other.instancesCulled;
+			instancesOccluded += other.instancesOccluded;
+			instancesTooSmall += other.instancesTooSmall;
+			clustersSubmitted += other.clustersSubmitted;
+			clustersCulled += other.clustersCulled;
+			verticesTransformed += other.verticesTransformed;
+			trianglesSubmitted += other.trianglesSubmitted;
+			trianglesCulled += other.trianglesCulled;
+			trianglesClipped += other.trianglesClipped;
+			trianglesRasterized += other.trianglesRasterized;
+			pixelsTested += other.pixelsTested;
+			pixelsDepthPassed += other.pixelsDepthPassed;
+			pixelsShaded += other.pixelsShaded;
+			textureFetches += other.textureFetches;
+			return *this;
+		}
+	};
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		enum class LightingMode
+		{
+			ObservedArea,
+			Diffuse,
+			Specular,
+			Combined,
+
+			enumSize
+		};
+
+		// Where the shading rate of every screen tile comes from, see SetShadingRateSource
+		enum class ShadingRateSource
+		{
+			Off,
+			Content,
+			Foveated,
+			Api,
+
+			enumSize
+		};
+
+		// Renders to the window, presenting on a separate thread
+		Renderer(SDL_Window* pWindow, const SceneDescription& scene = {});
+		// Headless, renders into an offscreen buffer without window or video subsystem
+		Renderer(int width, int height, const SceneDescription& scene = {});
 		~Renderer();
 
+		// False when the mesh or a texture of the scene failed to load, such a renderer must not Update or Render
+		bool IsLoaded() const { return m_IsLoaded; }
+
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(const Timer* pTimer);
+		void Update(float elapsedSec);
 
 		void ToggleDepthBuffer();
+		void ToggleOverdrawView();
+		void CycleDepthFormat();
 		void CycleLightingMode();
 		void ToggleUseNormals();
 		void ToggleRotation();
+		void CycleToneMapping();
+		void ChangeExposure(float stops);
+
+		// Explicit state for scripted runs, the toggles above are meant for key bindings
+		void SetLightingMode(LightingMode lightingMode);
+		void SetUseNormals(bool useNormals);
+		void SetDepthBufferView(bool isDepthBuffer);
+		void SetRotation(bool shouldSpin);
+
+		// Off by default, the mesh is drawn two-sided
+		// On, clusters whose normal cone faces away and triangles winding the other way on screen are dropped
+		void ToggleBackfaceCulling();
+		void SetBackfaceCulling(bool cullBackfaces);
+
+		// Off by default, costs more than it saves unless instances hide behind each other
+		// On, the visible instances covering the most pixels are drawn into a low resolution depth buffer first,
+		// and instances whose box is completely behind it are dropped before any vertex work
+		void ToggleOcclusionCulling();
+		void SetOcclusionCulling(bool isOcclusionCulling);
+
+		// On by default, every instance draws the coarsest level of detail of its mesh that stays within a pixel of the full mesh on screen
+		// and instances smaller than about a pixel are not drawn at all, off always draws the full meshes
+		void ToggleLodSelection();
+		void SetLodSelection(bool isLodSelection);
+
+		// Off (0) by default, with a target in milliseconds frames that take longer render at a lower internal resolution,
+		// which the resolve scales back up to the window, and the resolution comes back up once frames have time to spare
+		void SetFrameTimeTarget(float milliseconds);
+		// Fraction of the window width and height the next frame renders at, a frame time target keeps changing it
+		float GetResolutionScale() const { return m_ResolutionScale; }
+		void SetResolutionScale(float scale);
+		// Steers the resolution scale with the recent frame times of pTimer, Update(const Timer*) already calls it
+		void UpdateResolutionScale(const Timer* pTimer);
+
+		// Off by default, on jitters the projection by a different subpixel offset every frame and the resolve accumulates the frames
+		// into a history at the window resolution, following motion vectors from the raster stage, so frames rendered at a lower
+		// resolution scale still come out close to native
+		void ToggleTemporalUpsampling();
+		void SetTemporalUpsampling(bool isTemporalUpsampling);
+
+		// Off by default, on tests coverage and depth at m_SamplesPerPixel points per pixel and still shades once per pixel and triangle,
+		// the resolve averages the samples, so edges get supersampling quality without supersampling the shading
+		void ToggleMultisampling();
+		void SetMultisampling(bool isMultisampling);
+
+		// Off by default, every pixel is shaded, the others shade 2x2 or 4x4 pixel blocks of a tile with one ShadePixel call per triangle
+		// Content coarsens the tiles whose blocks barely varied in luminance last frame, Foveated the tiles further from the
+		// foveation center and Api takes the rates set per tile, depth and coverage stay per pixel (or sample) either way
+		void CycleShadingRateSource();
+		void SetShadingRateSource(ShadingRateSource source);
+		// UV of the point Foveated shades at the full rate around, the center of the screen by default
+		void SetFoveationCenter(const Vector2& center);
+		// Rate of a screen tile for the Api source, tiles are m_TileSize pixels of the rendered frame, all start at 1x1
+		void SetTileShadingRate(int tileX, int tileY, ShadingRate rate);
+
+		// Replaces the instances of the scene mesh, they all share its vertex data
+		// The rotation spins every instance around its own origin before its world matrix places it
+		void SetInstances(std::vector<MeshInstance> instances);
 
 		void Render();
 
-		bool SaveBufferToImage() const;
+		// Pipelined frames build the next frame's vertices and bins while the previous frame rasterizes, shades and resolves
+		// Throughput goes up and latency gets up to a frame longer, timings and statistics then lag one Render call behind
+		void SetPipelined(bool isPipelined);
+		// Waits for the frame that is still rasterizing in pipelined mode
+		void Flush();
 
-		void VertexTransformationFunction(const Matrix& world, const Matrix& worldViewProjectionMatrix, const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const;
-		ColorRGB ShadePixel(const Sample& sample) const;
+		void SetCollectTimings(bool collectTimings);
+		void SetInputEnabled(bool isInputEnabled);
+		const FrameTimings& GetFrameTimings() const { return m_FrameTimings; }
+		const PipelineStatistics& GetPipelineStatistics() const { return m_PipelineStatistics; }
+		// Transient memory of the last finished frame, all threads combined
+		const ArenaStatistics& GetArenaStatistics() const { return m_ArenaStatistics; }
+
+		// Flush first, so the image holds the last rendered frame
+		bool SaveBufferToImage();
+		bool SaveBufferToImage(const std::string& path);
 
 	private:
-		enum class LightingMode
+		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
+
+		// Pixel of the current triangle that passed the depth test, waiting to be shaded
+		struct Fragment
 		{
-			ObservedArea,
-			Diffuse,
-			Specular,
-			Combined,
+			int index{};
+			float depth{};
+			Sample sample{};
+			// Bit per sample that passed the depth test, only set with multisampling
+			uint8_t coverage{};
+		};
 
-			enumSize
+		// Pixels of a tile at a coarse shading rate that share one shaded color, and the fragment it is shaded at
+		struct ShadingBlock
+		{
+			int fragmentIndex{ -1 };
+			int distance{};
+			bool isShaded{};
+			ColorRGB color{};
+		};
+
+		// Triangle that passed setup, with its padded and screen clamped bounding box
+		struct SetupTriangle
+		{
+			Vertex vertex0{};
+			Vertex vertex1{};
+			Vertex vertex2{};
+			// Clip space corners under last frame's matrices, only set with temporal upsampling
+			Vector4 previous0{};
+			Vector4 previous1{};
+			Vector4 previous2{};
+			int xMin{};
+			int yMin{};
+			int xMax{};
+			int yMax{};
+		};
+
+		// One instance of one mesh that survived the frustum test
+		struct InstanceDraw
+		{
+			int meshIndex{};
+			// Into Mesh::lods, the meshlets of the clusters below belong to it
+			int lodIndex{};
+			Matrix worldMatrix{};
+			Matrix worldViewProjectionMatrix{};
+			// Last frame's spin and camera, only set with temporal upsampling
+			Matrix previousWorldViewProjectionMatrix{};
+			ColorRGB tint{};
+		};
+
+		// Meshlet of a draw that survived cluster culling, the vertex stage transforms the vertices of all of them in one go
+		struct ClusterDraw
+		{
+			int drawIndex{};
+			int meshletIndex{};
+			// Where the meshlet's transformed vertices start in FrameData::screenVertices
+			int firstVertex{};
 		};
-		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
+
+		// Consecutive clusters of one draw, set up and binned by one job
+		struct BinningChunk
+		{
+			int drawIndex{};
+			int firstCluster{};
+			int numClusters{};
+			int numTriangles{};
+		};
+		static constexpr int m_BinningChunkSize{ 512 };
+
+		// State the back end reads instead of the members, which Update and the key bindings change while it runs
+		struct RenderSettings
+		{
+			LightingMode lightingMode{};
+			Resolve::ToneMapping toneMapping{};
+			float exposure{};
+			bool useNormals{};
+			bool isDepthBuffer{};
+			bool isOverdrawView{};
+			bool collectTimings{};
+			bool cullBackfaces{};
+			bool isOcclusionCulling{};
+			bool isLodSelection{};
+			bool isTemporalUpsampling{};
+			bool isMultisampling{};
+			ShadingRateSource shadingRateSource{};
+		};
+
+		// Written by the front end (vertex, setup and binning), read by the back end (raster, shade, resolve and present)
+		// There are two, so the front end of the next frame can fill one while the back end of the previous frame reads the other
+		struct FrameData
+		{
+			// Backs every container below, reset by the front end before it fills them again
+			// Declared first, so it outlives them
+			FrameArena arena{};
+
+			RenderSettings settings{};
+			float zNear{};
+			float zFar{};
+			// Internal resolution, the frame uses the top of the color and depth buffers with rows this wide
+			int width{};
+			int height{};
+			int numTilesX{};
+			int numTilesY{};
+			// Projection offset of this frame and the previous one in UV units, motion vectors leave both out
+			Vector2 jitter{};
+			Vector2 previousJitter{};
+			Vector2 foveationCenter{};
+			uint64_t updateCounter{};
+
+			// Transformed vertices of all clusters after each other
+			ArenaVector<InstanceDraw> draws{};
+			ArenaVector<ClusterDraw> clusters{};
+			ArenaVector<Vertex> screenVertices{};
+			// Next to screenVertices, their clip space positions last frame, only filled with temporal upsampling
+			ArenaVector<Vector4> previousPositions{};
+			// Copy of the rates set per tile, only filled for the Api shading rate source
+			ArenaVector<ShadingRate> tileShadingRates{};
+
+			// Triangles of chunk c that passed setup go to chunkTriangles[c], allocated by the job that set them up
+			// tileBins[c * numTiles + tile] lists the ones overlapping the tile, tiles walk the chunks in order to keep submission order
+			ArenaVector<BinningChunk> binningChunks{};
+			ArenaVector<ArenaVector<SetupTriangle>> chunkTriangles{};
+			ArenaVector<ArenaVector<int>> tileBins{};
+
+			// Per chunk job copies, merged into statistics
+			ArenaVector<PipelineStatistics> chunkStatistics{};
+			PipelineStatistics statistics{};
+			FrameTimings timings{};
+		};
+		FrameData m_Frames[2]{};
+		int m_FrontEndFrame{};
+		int m_BackEndFrame{};
+
+		bool m_IsPipelined{ false };
+		// Back end of the frame in flight, only set in pipelined mode
+		JobHandle m_pBackEndJob{};
+		// Performance counter at the last Update, for the latency
+		uint64_t m_UpdateCounter{};
+
+		// Per tile job copies, back end only
+		std::vector<PipelineStatistics> m_TileStatistics{};
+
+		// Performance counter ticks the tile jobs spent rasterizing and shading, only measured when collecting timings
+		struct TileTimings
+		{
+			uint64_t raster{};
+			uint64_t shade{};
+		};
+		std::vector<TileTimings> m_TileTimings{};
+
+		bool m_IsInputEnabled{ true };
+		bool m_CollectTimings{ false };
+		FrameTimings m_FrameTimings{};
+		PipelineStatistics m_PipelineStatistics{};
+		ArenaStatistics m_ArenaStatistics{};
+
+		// Number of depth-passed fragments per pixel, only counted while the overdraw view is on
+		bool m_IsOverdrawView{ false };
+		std::vector<uint16_t> m_ShadeCounts{};
+
+		void Initialize(const SceneDescription& scene);
+		void UpdateSceneBvh();
+		void CullOccludedInstances(FrameData& frame, const Frustum& frustum, const Matrix& viewProjectionMatrix, ArenaVector<uint8_t>& isInstanceVisible);
+		void SelectLods(FrameData& frame, ArenaVector<uint8_t>& isInstanceVisible);
+		void RenderFrontEnd(FrameData& frame);
+		void RenderBackEnd(FrameData& frame);
+		void PublishFrame(const FrameData& frame);
+
+		// pIndices picks the input vertices, nullptr takes them in order, screen positions are for a width by height target
+		void TransformVertices(const Matrix& world, const Matrix& worldViewProjectionMatrix, const Vertex* pVerticesIn, const uint32_t* pIndices,
+			Vertex* pVerticesOut, int numVertices, int width, int height) const;
+		void TransformPreviousPositions(const Matrix& previousWorldViewProjectionMatrix, const Vertex* pVerticesIn, const uint32_t* pIndices,
+			Vector4* pPositionsOut, int numVertices) const;
+		void SetupAndBinTriangles(FrameData& frame, int chunkIndex);
+		void RasterizeTile(const FrameData& frame, int tileIndex);
+		void ClearTile(const FrameData& frame, int tileIndex);
+		// Averages the samples of a tile into the color buffer, after all of its triangles
+		void ResolveTileSamples(const FrameData& frame, int tileIndex);
+		// For resolves that read across tiles, the color of tiles no triangle touched and no motion
+		void FillUntouchedTiles(const FrameData& frame);
+		ColorRGB ShadePixel(const Sample& sample, const ColorRGB& tint, const RenderSettings& settings) const;
+
+		Resolve::ToneMapping m_CurrentToneMapping{ Resolve::ToneMapping::MaxToOne };
+		float m_Exposure{ 1.f };
 
 		SDL_Window* m_pWindow{};
 
-		SDL_Surface* m_pFrontBuffer{ nullptr };
+		// Either presents through m_pPresenter or, when headless, renders into m_pOffscreenBuffer
+		Presenter* m_pPresenter{ nullptr };
+		SDL_Surface* m_pOffscreenBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
-		//ColorRGB m_ClearColor{};
-		Uint8 r{ 100 };
-		Uint8 g{ 100 };
-		Uint8 b{ 100 };
-		Uint32 m_ClearColor{ static_cast<Uint32>(255 << 24) + static_cast<Uint32>(r << 16) + static_cast<Uint32>(g << 8) + static_cast<Uint32>(b) };
+		ColorRGB m_ClearColor{ 100.f / 255.f, 100.f / 255.f, 100.f / 255.f };
+
+		// Planar HDR float color, tone mapped and packed into the back buffer by Resolve::PackToPixels at the end of the frame
+		// Sized for the window, frames at a lower internal resolution use the start of it and get upscaled when resolving
+		float* m_pColorBufferPixels{};
+		float* m_pColorBufferRed{};
+		float* m_pColorBufferGreen{};
+		float* m_pColorBufferBlue{};
+
+		// Planar motion vectors next to the color, written for every depth-passed fragment with temporal upsampling
+		float* m_pMotionBufferPixels{};
+		float* m_pMotionBufferX{};
+		float* m_pMotionBufferY{};
+
+		// Screen tiles with a per-frame "cleared" flag, see ClearTile, counted for the window and only partly used at lower resolutions
+		static constexpr int m_TileSize{ 32 };
+		int m_NumTilesX{};
+		int m_NumTilesY{};
+		std::vector<uint8_t> m_TileCleared{};
 
 		std::vector<Mesh> m_Meshes{};
 		Texture* m_TexturePtr{};
 
+		// Every instance of every mesh in draw order, with its world space box
+		// The BVH over them is rebuilt when instances are replaced and refit when the spin moves them
+		struct SceneInstance
+		{
+			int meshIndex{};
+			int instanceIndex{};
+		};
+		std::vector<SceneInstance> m_SceneInstances{};
+		std::vector<BoundingBox> m_InstanceBounds{};
+		Bvh m_SceneBvh{};
+		bool m_IsSceneBvhStale{ true };
+		bool m_AreInstanceBoundsDirty{ true };
+
+		// Front end only, so one is enough in pipelined mode, its height follows the aspect ratio
+		static constexpr int m_OcclusionBufferWidth{ 320 };
+		static constexpr int m_MaxOccluders{ 8 };
+		bool m_IsOcclusionCulling{ false };
+		OcclusionBuffer m_OcclusionBuffer{};
+
+		// Level of detail of every scene instance, kept between frames for the hysteresis
+		// A level is fine while its error stays under m_MaxLodError pixels, the next coarser one is only taken once its error
+		// drops under m_LodHysteresis times that, so an instance sitting right at a switching distance does not flicker between them
+		static constexpr int m_MaxLods{ 5 };
+		static constexpr float m_MaxLodError{ 1.f };
+		static constexpr float m_LodHysteresis{ .5f };
+		// Instances whose bounding sphere is smaller than this radius in pixels are culled
+		static constexpr float m_MinInstanceRadius{ 1.f };
+		bool m_IsLodSelection{ true };
+		std::vector<uint8_t> m_InstanceLods{};
+
 		Texture* m_VehicleDiffusePtr{};
 		Texture* m_VehicleGlossPtr{};
 		Texture* m_VehicleNormalPtr{};
 		Texture* m_VehicleSpecularPtr{};
+		bool m_IsLoaded{};
 
 		float m_TotalRotation{};
+		// Applied to every instance before its own world matrix
+		Matrix m_SpinRotation{};
 
 		bool m_isDepthBuffer{};
 		bool m_IsDepthBuffer{};
 		bool m_ShouldSpin{ true };
+		bool m_CullBackfaces{ false };
 		bool m_Normalz{ true };
 
-		float* m_pDepthBufferPixels{};
+		DepthBuffer m_DepthBuffer{};
 
 		Camera m_Camera{};
 
 		int m_Width{};
 		int m_Height{};
+
+		// Dynamic resolution, the scale moves after every m_FrameTimeWindow frames at the same scale
+		// Cost goes with the pixel count, so the scale follows the square root of target over frame time
+		// It drops at once when frames run over and only comes back up slowly, once they are comfortably under the target
+		static constexpr int m_FrameTimeWindow{ 8 };
+		static constexpr float m_MinResolutionScale{ .5f };
+		static constexpr float m_ResolutionHeadroom{ .9f };
+		static constexpr float m_MaxResolutionStep{ 1.1f };
+		float m_FrameTimeTarget{};
+		float m_ResolutionScale{ 1.f };
+		int m_FramesAtResolution{};
+
+		// Temporal upsampling, the jitter runs through m_JitterPhasesPerPixel phases per window pixel that falls on a rendered pixel
+		// The previous matrices and jitter are kept by the front end for the motion vectors, the history by the back end
+		static constexpr int m_JitterPhasesPerPixel{ 8 };
+		bool m_IsTemporalUpsampling{ false };
+		int m_JitterIndex{};
+		Vector2 m_PreviousJitter{};
+		Matrix m_PreviousSpinRotation{};
+		Matrix m_PreviousViewProjectionMatrix{};
+		TemporalUpsampler m_TemporalUpsampler{};
+
+		// Multisampling, the rotated grid of four samples on a 4x4 subpixel grid, offsets from the pixel center
+		// The offsets average out to the center, so a pixel all samples cover is shaded at its center
+		static constexpr int m_SamplesPerPixel{ 4 };
+		static constexpr Vector2 m_SampleOffsets[m_SamplesPerPixel]{ { -.125f, -.375f }, { .375f, -.125f }, { -.375f, .125f }, { .125f, .375f } };
+		bool m_IsMultisampling{ false };
+		// Planar HDR color and depth of every sample, the samples of a pixel next to each other, allocated on first use
+		float* m_pSampleBufferPixels{};
+		float* m_pSampleBufferRed{};
+		float* m_pSampleBufferGreen{};
+		float* m_pSampleBufferBlue{};
+		DepthBuffer m_SampleDepthBuffer{};
+
+		// Variable rate shading, the rates set through the API are kept for the window's tiles, the map of the frame by the back end
+		ShadingRateSource m_ShadingRateSource{ ShadingRateSource::Off };
+		Vector2 m_FoveationCenter{ .5f, .5f };
+		std::vector<ShadingRate> m_TileShadingRates{};
+		ShadingRateMap m_ShadingRateMap{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "Resolve.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+#include "SDL_pixels.h"
+
+namespace
+{
+	// Tone maps 4 pixels of exposed HDR color in place
+	inline void ToneMap4(__m128& r, __m128& g, __m128& b, Resolve::ToneMapping toneMapping)
+	{
+		const __m128 one{ _mm_set1_ps(1.f) };
+
+		switch (toneMapping)
+		{
+		case Resolve::ToneMapping::MaxToOne:
+		{
+			// Same as ColorRGB::MaxToOne, divide by the largest channel when it exceeds 1
+			const __m128 invMax{ _mm_div_ps(one, _mm_max_ps(_mm_max_ps(r, _mm_max_ps(g, b)), one)) };
+			r = _mm_mul_ps(r, invMax);
+			g = _mm_mul_ps(g, invMax);
+			b = _mm_mul_ps(b, invMax);
+			break;
+		}
+		case Resolve::ToneMapping::Reinhard:
+		{
+			// c / (1 + c)
+			r = _mm_div_ps(r, _mm_add_ps(r, one));
+			g = _mm_div_ps(g, _mm_add_ps(g, one));
+			b = _mm_div_ps(b, _mm_add_ps(b, one));
+			break;
+		}
+		case Resolve::ToneMapping::ACES:
+		{
+			// Krzysztof Narkowicz' ACES filmic curve fit: (c * (2.51c + .03)) / (c * (2.43c + .59) + .14)
+			const __m128 a{ _mm_set1_ps(2.51f) };
+			const __m128 bb{ _mm_set1_ps(.03f) };
+			const __m128 c{ _mm_set1_ps(2.43f) };
+			const __m128 d{ _mm_set1_ps(.59f) };
+			const __m128 e{ _mm_set1_ps(.14f) };
+
+			auto aces = [&](const __m128& x)
+			{
+				const __m128 numerator{ _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, a), bb)) };
+				const __m128 denominator{ _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, c), d)), e) };
+				return _mm_div_ps(numerator, denominator);
+			};
+
+			r = aces(r);
+			g = aces(g);
+			b = aces(b);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+void Resolve::PackToPixels(const float* pRed, const float* pGreen, const float* pBlue, uint32_t* pPixels, int count, const SDL_PixelFormat* pFormat,
+	ToneMapping toneMapping, float exposure)
+{
+	const __m128i rShift{ _mm_cvtsi32_si128(pFormat->Rshift) };
+	const __m128i gShift{ _mm_cvtsi32_si128(pFormat->Gshift) };
+	const __m128i bShift{ _mm_cvtsi32_si128(pFormat->Bshift) };
+	const __m128i alpha{ _mm_set1_epi32(static_cast<int>(pFormat->Amask)) };
+
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 scale{ _mm_set1_ps(255.f) };
+	const __m128 exposureScale{ _mm_set1_ps(exposure) };
+
+	// 4 pixels per iteration: expose, tone map, clamp, scale, round to int and shift every channel into place
+	int i{};
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 r{ _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pRed + i), exposureScale), zero) };
+		__m128 g{ _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pGreen + i), exposureScale), zero) };
+		__m128 b{ _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pBlue + i), exposureScale), zero) };
+
+		ToneMap4(r, g, b, toneMapping);
+
+		r = _mm_mul_ps(_mm_min_ps(r, one), scale);
+		g = _mm_mul_ps(_mm_min_ps(g, one), scale);
+		b = _mm_mul_ps(_mm_min_ps(b, one), scale);
+
+		__m128i packed{ _mm_sll_epi32(_mm_cvtps_epi32(r), rShift) };
+		packed = _mm_or_si128(packed, _mm_sll_epi32(_mm_cvtps_epi32(g), gShift));
+		packed = _mm_or_si128(packed, _mm_sll_epi32(_mm_cvtps_epi32(b), bShift));
+		packed = _mm_or_si128(packed, alpha);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), packed);
+	}
+
+	// Remaining pixels go through the same path, padded to a full register
+	if (i < count)
+	{
+		alignas(16) float red[4]{}, green[4]{}, blue[4]{};
+		alignas(16) uint32_t pixels[4]{};
+
+		const int remaining{ count - i };
+		std::copy_n(pRed + i, remaining, red);
+		std::copy_n(pGreen + i, remaining, green);
+		std::copy_n(pBlue + i, remaining, blue);
+
+		PackToPixels(red, green, blue, pixels, 4, pFormat, toneMapping, exposure);
+
+		std::copy_n(pixels, remaining, pPixels + i);
+	}
+}
+
+void Resolve::Fill(float* pRed, float* pGreen, float* pBlue, int count, float r, float g, float b)
+{
+	std::fill_n(pRed, count, r);
+	std::fill_n(pGreen, count, g);
+	std::fill_n(pBlue, count, b);
+}
+
+void Resolve::AverageSamples(const float* pRedSamples, const float* pGreenSamples, const float* pBlueSamples, int numSamples,
+	float* pRed, float* pGreen, float* pBlue, int count)
+{
+	const float invNumSamples{ 1.f / static_cast<float>(numSamples) };
+	const auto average = [numSamples, invNumSamples](const float* pSamples)
+	{
+		float sum{};
+		for (int sample{}; sample < numSamples; ++sample)
+			sum += pSamples[sample];
+		return sum * invNumSamples;
+	};
+
+	for (int i{}; i < count; ++i)
+	{
+		pRed[i] = average(pRedSamples + i * numSamples);
+		pGreen[i] = average(pGreenSamples + i * numSamples);
+		pBlue[i] = average(pBlueSamples + i * numSamples);
+	}
+}
+
+void Resolve::StreamFill(uint32_t* pPixels, int count, uint32_t value)
+{
+	int i{};
+
+	// _mm_stream_si128 needs 16 byte aligned addresses
+	for (; i < count && (reinterpret_cast<uintptr_t>(pPixels + i) & 15) != 0; ++i)
+		pPixels[i] = value;
+
+	const __m128i values{ _mm_set1_epi32(static_cast<int>(value)) };
+	for (; i + 4 <= count; i += 4)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pPixels + i), values);
+
+	for (; i < count; ++i)
+		pPixels[i] = value;
+
+	_mm_sfence();
+}
+
+void Resolve::ComputeBilinearTaps(int sourceWidth, BilinearTap* pTaps, int count)
+{
+	const float scale{ static_cast<float>(sourceWidth) / static_cast<float>(count) };
+	for (int i{}; i < count; ++i)
+	{
+		// Clamped to the edge pixels, like a clamp sampler
+		const float x{ std::clamp((static_cast<float>(i) + .5f) * scale - .5f, 0.f, static_cast<float>(sourceWidth - 1)) };
+		const int x0{ static_cast<int>(x) };
+		pTaps[i] = { x0, std::min(x0 + 1, sourceWidth - 1), x - static_cast<float>(x0) };
+	}
+}
+
+void Resolve::UpscaleRow(const float* pRed0, const float* pGreen0, const float* pBlue0, const float* pRed1, const float* pGreen1, const float* pBlue1,
+	float rowWeight, const BilinearTap* pTaps, float* pRedOut, float* pGreenOut, float* pBlueOut, int count)
+{
+	const auto sample = [rowWeight](const float* pRow0, const float* pRow1, const BilinearTap& tap)
+	{
+		const float top{ pRow0[tap.x0] + (pRow0[tap.x1] - pRow0[tap.x0]) * tap.weight };
+		const float bottom{ pRow1[tap.x0] + (pRow1[tap.x1] - pRow1[tap.x0]) * tap.weight };
+		return top + (bottom - top) * rowWeight;
+	};
+
+	for (int i{}; i < count; ++i)
+	{
+		pRedOut[i] = sample(pRed0, pRed1, pTaps[i]);
+		pGreenOut[i] = sample(pGreen0, pGreen1, pTaps[i]);
+		pBlueOut[i] = sample(pBlue0, pBlue1, pTaps[i]);
+	}
+}
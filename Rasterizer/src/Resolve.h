@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+struct SDL_PixelFormat;
+
+namespace Resolve
+{
+	enum class ToneMapping
+	{
+		MaxToOne,
+		Reinhard,
+		ACES,
+
+		enumSize
+	};
+
+	// Applies exposure and tone mapping to planar HDR color, then packs it into 32-bit pixels in the channel order of pFormat
+	void PackToPixels(const float* pRed, const float* pGreen, const float* pBlue, uint32_t* pPixels, int count, const SDL_PixelFormat* pFormat,
+		ToneMapping toneMapping = ToneMapping::MaxToOne, float exposure = 1.f);
+
+	// Fills planar float color with a single value
+	void Fill(float* pRed, float* pGreen, float* pBlue, int count, float r, float g, float b);
+
+	// Averages every numSamples consecutive samples of planar color into one pixel, count pixels
+	void AverageSamples(const float* pRedSamples, const float* pGreenSamples, const float* pBlueSamples, int numSamples,
+		float* pRed, float* pGreen, float* pBlue, int count);
+
+	// Fills pixels with non-temporal stores, for memory that will not be read again this frame
+	void StreamFill(uint32_t* pPixels, int count, uint32_t value);
+
+	// Where a destination column samples its source row, the two source columns and the weight of the second
+	struct BilinearTap
+	{
+		int x0{};
+		int x1{};
+		float weight{};
+	};
+
+	// Taps for scaling sourceWidth columns to count columns, pixel centers line up like in a texture lookup
+	void ComputeBilinearTaps(int sourceWidth, BilinearTap* pTaps, int count);
+
+	// One row of planar color, blended from two source rows by rowWeight and across the columns by pTaps, into pRedOut and friends
+	void UpscaleRow(const float* pRed0, const float* pGreen0, const float* pBlue0, const float* pRed1, const float* pGreen1, const float* pBlue1,
+		float rowWeight, const BilinearTap* pTaps, float* pRedOut, float* pGreenOut, float* pBlueOut, int count);
+}
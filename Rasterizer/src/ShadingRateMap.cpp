@@ -0,0 +1,151 @@
+#include "ShadingRateMap.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	// Share of the blockSize by blockSize blocks whose luminance variance stays under maxVariance
+	// Blocks cut off by the tile edge use the pixels they have
+	float FlatBlockShare(const float* pLuminance, int width, int height, int blockSize, float maxVariance)
+	{
+		int numFlatBlocks{};
+		int numBlocks{};
+		for (int blockY{}; blockY < height; blockY += blockSize)
+		{
+			for (int blockX{}; blockX < width; blockX += blockSize)
+			{
+				const int xMax{ std::min(blockX + blockSize, width) };
+				const int yMax{ std::min(blockY + blockSize, height) };
+
+				float sum{};
+				float sumOfSquares{};
+				for (int y{ blockY }; y < yMax; ++y)
+				{
+					for (int x{ blockX }; x < xMax; ++x)
+					{
+						const float luminance{ pLuminance[x + y * width] };
+						sum += luminance;
+						sumOfSquares += luminance * luminance;
+					}
+				}
+
+				const float invCount{ 1.f / static_cast<float>((xMax - blockX) * (yMax - blockY)) };
+				const float mean{ sum * invCount };
+				if (sumOfSquares * invCount - mean * mean < maxVariance)
+					++numFlatBlocks;
+				++numBlocks;
+			}
+		}
+
+		return static_cast<float>(numFlatBlocks) / static_cast<float>(numBlocks);
+	}
+}
+
+void ShadingRateMap::Fill(int numTilesX, int numTilesY, ShadingRate rate)
+{
+	Resize(numTilesX, numTilesY);
+	std::fill(m_Rates.begin(), m_Rates.end(), rate);
+}
+
+void ShadingRateMap::Select(int numTilesX, int numTilesY, const ShadingRate* pRates)
+{
+	Resize(numTilesX, numTilesY);
+	std::copy_n(pRates, m_Rates.size(), m_Rates.begin());
+}
+
+void ShadingRateMap::SelectFoveated(int numTilesX, int numTilesY, int tileSize, int width, int height, const Vector2& center)
+{
+	Resize(numTilesX, numTilesY);
+
+	const Vector2 centerPixel{ center.x * static_cast<float>(width), center.y * static_cast<float>(height) };
+	const float invHeight{ 1.f / static_cast<float>(height) };
+	for (int tileY{}; tileY < numTilesY; ++tileY)
+	{
+		for (int tileX{}; tileX < numTilesX; ++tileX)
+		{
+			// Point of the tile nearest to the center
+			const Vector2 nearest{
+				std::clamp(centerPixel.x, static_cast<float>(tileX * tileSize), static_cast<float>(std::min((tileX + 1) * tileSize, width))),
+				std::clamp(centerPixel.y, static_cast<float>(tileY * tileSize), static_cast<float>(std::min((tileY + 1) * tileSize, height))) };
+			const float distance{ (nearest - centerPixel).Magnitude() * invHeight };
+
+			m_Rates[tileX + tileY * numTilesX] = distance < m_FoveaRadius ? ShadingRate::Rate1x1
+				: (distance < m_PeripheryRadius ? ShadingRate::Rate2x2 : ShadingRate::Rate4x4);
+		}
+	}
+}
+
+void ShadingRateMap::SelectFromContent(int numTilesX, int numTilesY)
+{
+	if (numTilesX != m_MeasuredTilesX || numTilesY != m_MeasuredTilesY)
+	{
+		// Measurements of another tile grid, or none at all
+		Fill(numTilesX, numTilesY, ShadingRate::Rate1x1);
+	}
+	else
+	{
+		for (size_t tileIndex{}; tileIndex < m_Rates.size(); ++tileIndex)
+		{
+			const Measurement& measurement{ m_Measurements[tileIndex] };
+			ShadingRate rate{ ShadingRate::Rate1x1 };
+			if (measurement.flatShare2x2 >= 0.f)
+			{
+				if (measurement.flatShare4x4 >= m_MinFlatBlockShare)
+					rate = ShadingRate::Rate4x4;
+				else if (measurement.flatShare2x2 >= m_MinFlatBlockShare)
+					rate = ShadingRate::Rate2x2;
+
+				// Coarser by one step per frame at most, finer at once, so content moving into a tile is not shaded coarse for long
+				rate = std::min(rate, ShadingRate(static_cast<int>(m_Rates[tileIndex]) + 1));
+			}
+			m_Rates[tileIndex] = rate;
+		}
+		m_Measurements.assign(m_Rates.size(), {});
+	}
+
+	m_MeasuredTilesX = numTilesX;
+	m_MeasuredTilesY = numTilesY;
+}
+
+void ShadingRateMap::MeasureTile(int tileIndex, const float* pRed, const float* pGreen, const float* pBlue, int stride, int width, int height)
+{
+	// Clamped to the range MaxToOne tone mapping displays, variance above white is not visible
+	thread_local std::vector<float> luminances{};
+	luminances.resize(static_cast<size_t>(width) * height);
+	for (int y{}; y < height; ++y)
+	{
+		for (int x{}; x < width; ++x)
+		{
+			const int index{ x + y * stride };
+			luminances[x + y * width] = std::min(.2126f * pRed[index] + .7152f * pGreen[index] + .0722f * pBlue[index], 1.f);
+		}
+	}
+
+	Measurement& measurement{ m_Measurements[tileIndex] };
+	const int blockSize{ GetBlockSize(m_Rates[tileIndex]) };
+	if (blockSize == 1)
+	{
+		measurement.flatShare2x2 = FlatBlockShare(luminances.data(), width, height, 2, m_MaxBlockVariance);
+		measurement.flatShare4x4 = FlatBlockShare(luminances.data(), width, height, 4, m_MaxBlockVariance);
+		return;
+	}
+
+	// A block of the tile's own rate holds a single color, only blocks twice that size still vary
+	// Smooth shading varies with the square of the block size, so the larger blocks may vary that much more
+	const int measuredSize{ 2 * blockSize };
+	const float sizeRatio2x2{ static_cast<float>(measuredSize) / 2.f };
+	const float sizeRatio4x4{ static_cast<float>(measuredSize) / 4.f };
+	measurement.flatShare2x2 = FlatBlockShare(luminances.data(), width, height, measuredSize, m_MaxBlockVariance * sizeRatio2x2 * sizeRatio2x2);
+	measurement.flatShare4x4 = FlatBlockShare(luminances.data(), width, height, measuredSize, m_MaxBlockVariance * sizeRatio4x4 * sizeRatio4x4);
+}
+
+void ShadingRateMap::Resize(int numTilesX, int numTilesY)
+{
+	// Picking from anything else than content leaves no measurements for the next frame
+	m_Rates.resize(static_cast<size_t>(numTilesX) * numTilesY);
+	m_Measurements.assign(m_Rates.size(), {});
+	m_MeasuredTilesX = 0;
+	m_MeasuredTilesY = 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Maths.h"
+
+namespace dae
+{
+	// Pixels per ShadePixel call, a block that many pixels wide and high shares one shaded color
+	enum class ShadingRate : uint8_t
+	{
+		Rate1x1,
+		Rate2x2,
+		Rate4x4,
+
+		enumSize
+	};
+
+	// Shading rate of every screen tile of a frame, picked before the tiles rasterize
+	// Content picks the coarsest rate whose blocks barely varied in luminance last frame, which needs every touched tile measured
+	// with MeasureTile once it is shaded, tiles without a measurement shade at the full rate
+	class ShadingRateMap final
+	{
+	public:
+		static int GetBlockSize(ShadingRate rate) { return 1 << static_cast<int>(rate); }
+
+		ShadingRate GetRate(int tileIndex) const { return m_Rates[tileIndex]; }
+
+		// Every tile at the same rate
+		void Fill(int numTilesX, int numTilesY, ShadingRate rate);
+		// numTilesX * numTilesY rates, row by row
+		void Select(int numTilesX, int numTilesY, const ShadingRate* pRates);
+		// Full rate around center (UV) and coarser further out, tiles are tileSize pixels of a width by height frame
+		void SelectFoveated(int numTilesX, int numTilesY, int tileSize, int width, int height, const Vector2& center);
+		// From the measurements of the last frame, then starts over with none for this frame
+		void SelectFromContent(int numTilesX, int numTilesY);
+
+		// Luminance of a tile shaded at its rate of this frame, rows of planar HDR color stride floats apart
+		// Tiles are independent, so they can be measured from the jobs that shaded them
+		void MeasureTile(int tileIndex, const float* pRed, const float* pGreen, const float* pBlue, int stride, int width, int height);
+
+	private:
+		// Variance of the display luminance inside a 2x2 block that still passes as a single color, about 3/255 standard deviation
+		static constexpr float m_MaxBlockVariance{ (3.f / 255.f) * (3.f / 255.f) };
+		// Share of the blocks that has to pass for a tile to shade at that rate, the rest is mostly silhouettes,
+		// which keep their per-pixel coverage and depth at any rate
+		static constexpr float m_MinFlatBlockShare{ .75f };
+		// Distance from the foveation center up to which tiles shade at 1x1 and at 2x2, in frame heights
+		static constexpr float m_FoveaRadius{ .2f };
+		static constexpr float m_PeripheryRadius{ .45f };
+
+		// Share of the blocks of each coarse rate that would pass as a single color, negative for tiles that were not measured
+		struct Measurement
+		{
+			float flatShare2x2{ -1.f };
+			float flatShare4x4{ -1.f };
+		};
+
+		std::vector<ShadingRate> m_Rates{};
+		std::vector<Measurement> m_Measurements{};
+		// Tiles the measurements were taken for, none when the last frame did not pick from content
+		int m_MeasuredTilesX{};
+		int m_MeasuredTilesY{};
+
+		void Resize(int numTilesX, int numTilesY);
+	};
+}
@@ -0,0 +1,206 @@
+#include "TemporalUpsampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+namespace
+{
+	float RadicalInverse(int index, int base)
+	{
+		float result{};
+		float fraction{ 1.f };
+		while (index > 0)
+		{
+			fraction /= static_cast<float>(base);
+			result += fraction * static_cast<float>(index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	// Weights of the samples at -1, 0, 1 and 2 around a point t past sample 0
+	void CatmullRomWeights(float t, float* pWeights)
+	{
+		const float t2{ t * t };
+		const float t3{ t2 * t };
+		pWeights[0] = .5f * (-t3 + 2.f * t2 - t);
+		pWeights[1] = .5f * (3.f * t3 - 5.f * t2 + 2.f);
+		pWeights[2] = .5f * (-3.f * t3 + 4.f * t2 + t);
+		pWeights[3] = .5f * (t3 - t2);
+	}
+}
+
+void TemporalUpsampler::Initialize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Size = width * height;
+	for (std::vector<float>& history : m_History)
+		history.assign(static_cast<size_t>(m_Size) * 4, 0.f);
+	m_IsHistoryValid = false;
+}
+
+Vector2 TemporalUpsampler::GetJitter(int frameIndex, int numPhases)
+{
+	// Index 0 of the sequence is the pixel corner for every base, start at 1
+	const int index{ frameIndex % std::max(numPhases, 1) + 1 };
+	return { RadicalInverse(index, 2) - .5f, RadicalInverse(index, 3) - .5f };
+}
+
+void TemporalUpsampler::BeginFrame(const Input& input)
+{
+	m_Input = input;
+
+	// Input pixels per output pixel, the sample of input pixel i sits at i + .5 - jitter without the jitter
+	const float scaleX{ static_cast<float>(input.width) / static_cast<float>(m_Width) };
+	m_Columns.resize(m_Width);
+	for (int x{}; x < m_Width; ++x)
+	{
+		const float u{ (static_cast<float>(x) + .5f) * scaleX };
+		const int sampleX{ std::clamp(static_cast<int>(std::floor(u + input.jitter.x)), 0, input.width - 1) };
+		const float dx{ (static_cast<float>(sampleX) + .5f - input.jitter.x - u) / scaleX };
+		m_Columns[x] = { sampleX, std::exp(-m_SampleSharpness * dx * dx) };
+	}
+}
+
+void TemporalUpsampler::ResolveRow(int row)
+{
+	const Input& input{ m_Input };
+	const float* pOldRed{ m_History[1 - m_Current].data() };
+	const float* pOldGreen{ pOldRed + m_Size };
+	const float* pOldBlue{ pOldGreen + m_Size };
+	const float* pOldWeight{ pOldBlue + m_Size };
+
+	float* pRed{ m_History[m_Current].data() + row * m_Width };
+	float* pGreen{ pRed + m_Size };
+	float* pBlue{ pGreen + m_Size };
+	float* pWeight{ pBlue + m_Size };
+
+	const float scaleY{ static_cast<float>(input.height) / static_cast<float>(m_Height) };
+	const float v{ (static_cast<float>(row) + .5f) * scaleY };
+	const int sampleY{ std::clamp(static_cast<int>(std::floor(v + input.jitter.y)), 0, input.height - 1) };
+	const float dy{ (static_cast<float>(sampleY) + .5f - input.jitter.y - v) / scaleY };
+	const float rowWeight{ std::exp(-m_SampleSharpness * dy * dy) };
+
+	// Box around the colors next to every sample of the row, history outside of it belongs to something else
+	// Minimum and maximum of red, green and blue, over the three rows first and then over three columns
+	thread_local std::vector<float> neighborhood{};
+	const int width{ input.width };
+	neighborhood.resize(static_cast<size_t>(width) * 12);
+	float* pColumnBox{ neighborhood.data() };
+	float* pBox{ pColumnBox + width * 6 };
+
+	const int sampleRows[3]{ std::max(sampleY - 1, 0) * width, sampleY * width, std::min(sampleY + 1, input.height - 1) * width };
+	const float* pChannels[3]{ input.pRed, input.pGreen, input.pBlue };
+	for (int channel{}; channel < 3; ++channel)
+	{
+		const float* pRow0{ pChannels[channel] + sampleRows[0] };
+		const float* pRow1{ pChannels[channel] + sampleRows[1] };
+		const float* pRow2{ pChannels[channel] + sampleRows[2] };
+		float* pMinimum{ pColumnBox + channel * 2 * width };
+		float* pMaximum{ pMinimum + width };
+		for (int i{}; i < width; ++i)
+		{
+			pMinimum[i] = std::min(pRow0[i], std::min(pRow1[i], pRow2[i]));
+			pMaximum[i] = std::max(pRow0[i], std::max(pRow1[i], pRow2[i]));
+		}
+
+		float* pBoxMinimum{ pBox + channel * 2 * width };
+		float* pBoxMaximum{ pBoxMinimum + width };
+		for (int i{}; i < width; ++i)
+		{
+			const int left{ std::max(i - 1, 0) };
+			const int right{ std::min(i + 1, width - 1) };
+			pBoxMinimum[i] = std::min(pMinimum[left], std::min(pMinimum[i], pMinimum[right]));
+			pBoxMaximum[i] = std::max(pMaximum[left], std::max(pMaximum[i], pMaximum[right]));
+		}
+	}
+
+	const float* pSampleRed{ input.pRed + sampleRows[1] };
+	const float* pSampleGreen{ input.pGreen + sampleRows[1] };
+	const float* pSampleBlue{ input.pBlue + sampleRows[1] };
+	const float* pMotionX{ input.pMotionX + sampleRows[1] };
+	const float* pMotionY{ input.pMotionY + sampleRows[1] };
+
+	for (int x{}; x < m_Width; ++x)
+	{
+		const Column& column{ m_Columns[x] };
+		const int sampleX{ column.sampleX };
+		const float sampleWeight{ column.weight * rowWeight };
+		const ColorRGB sample{ pSampleRed[sampleX], pSampleGreen[sampleX], pSampleBlue[sampleX] };
+
+		// Where this pixel was last frame, in output pixels with the centers on whole numbers
+		ColorRGB history{};
+		float historyWeight{};
+		const float historyX{ static_cast<float>(x) - pMotionX[sampleX] * static_cast<float>(m_Width) };
+		const float historyY{ static_cast<float>(row) - pMotionY[sampleX] * static_cast<float>(m_Height) };
+		if (m_IsHistoryValid && historyX > -.5f && historyY > -.5f && historyX < static_cast<float>(m_Width) - .5f && historyY < static_cast<float>(m_Height) - .5f)
+		{
+			// Floor, both are above -1 here and truncating is cheaper than a std::floor call
+			const int x0{ static_cast<int>(historyX + 1.f) - 1 };
+			const int y0{ static_cast<int>(historyY + 1.f) - 1 };
+			const float fractionX{ historyX - static_cast<float>(x0) };
+			const float fractionY{ historyY - static_cast<float>(y0) };
+
+			if (fractionX == 0.f && fractionY == 0.f)
+			{
+				// Still, which includes everything the clear color covers
+				const int index{ x0 + y0 * m_Width };
+				history = { pOldRed[index], pOldGreen[index], pOldBlue[index] };
+				historyWeight = pOldWeight[index];
+			}
+			else
+			{
+				// Catmull-Rom for the color, resampling bilinearly every frame would keep blurring whatever moves
+				// The inner four taps are the bilinear ones, the weight has no edges to keep sharp
+				float weightsX[4]{};
+				float weightsY[4]{};
+				CatmullRomWeights(fractionX, weightsX);
+				CatmullRomWeights(fractionY, weightsY);
+
+				int columns[4]{};
+				for (int tap{}; tap < 4; ++tap)
+					columns[tap] = std::clamp(x0 - 1 + tap, 0, m_Width - 1);
+
+				for (int tapY{}; tapY < 4; ++tapY)
+				{
+					const int rowOffset{ std::clamp(y0 - 1 + tapY, 0, m_Height - 1) * m_Width };
+					ColorRGB rowColor{};
+					for (int tapX{}; tapX < 4; ++tapX)
+					{
+						const int index{ rowOffset + columns[tapX] };
+						rowColor += ColorRGB{ pOldRed[index], pOldGreen[index], pOldBlue[index] } * weightsX[tapX];
+					}
+					history += rowColor * weightsY[tapY];
+
+					if (tapY == 1 || tapY == 2)
+					{
+						const float bilinearY{ tapY == 1 ? 1.f - fractionY : fractionY };
+						historyWeight += (pOldWeight[rowOffset + columns[1]] * (1.f - fractionX) + pOldWeight[rowOffset + columns[2]] * fractionX) * bilinearY;
+					}
+				}
+			}
+
+			// Also takes out the ringing of the negative lobes
+			history = {
+				std::clamp(history.r, pBox[sampleX], pBox[width + sampleX]),
+				std::clamp(history.g, pBox[2 * width + sampleX], pBox[3 * width + sampleX]),
+				std::clamp(history.b, pBox[4 * width + sampleX], pBox[5 * width + sampleX]) };
+		}
+
+		const float totalWeight{ historyWeight + sampleWeight };
+		const ColorRGB color{ (history * historyWeight + sample * sampleWeight) / totalWeight };
+		pRed[x] = color.r;
+		pGreen[x] = color.g;
+		pBlue[x] = color.b;
+		pWeight[x] = std::min(totalWeight, m_MaxHistoryWeight);
+	}
+}
+
+void TemporalUpsampler::EndFrame()
+{
+	m_Current = 1 - m_Current;
+	m_IsHistoryValid = true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+
+#include "Maths.h"
+
+namespace dae
+{
+	// Temporal reconstruction of frames rendered at up to the output resolution, with a subpixel jitter that changes every frame
+	// Every output pixel blends its reprojected history with the nearest new sample, weighted by how close that sample lands,
+	// after clamping the history to the colors around the sample, so stale colors of disoccluded or changed surfaces do not linger
+	class TemporalUpsampler final
+	{
+	public:
+		// Planar color and motion of the new frame, rows are width wide
+		struct Input
+		{
+			const float* pRed{};
+			const float* pGreen{};
+			const float* pBlue{};
+			// UV units, from where a surface was last frame to where it is now, without the jitter
+			const float* pMotionX{};
+			const float* pMotionY{};
+			int width{};
+			int height{};
+			// Offset the projection moved the samples by, in input pixels
+			Vector2 jitter{};
+		};
+
+		void Initialize(int width, int height);
+		bool IsInitialized() const { return m_Size > 0; }
+		// The next frame starts over from its own samples
+		void Invalidate() { m_IsHistoryValid = false; }
+
+		// Point frameIndex of the Halton (2, 3) sequence, centered on the pixel so in [-.5, .5), repeating after numPhases frames
+		static Vector2 GetJitter(int frameIndex, int numPhases);
+
+		// A frame is BeginFrame, ResolveRow for every output row and EndFrame, input has to stay valid until EndFrame
+		void BeginFrame(const Input& input);
+		// Reconstructs one output row into the new history, rows are independent so they can be split over jobs
+		void ResolveRow(int row);
+		// The new history becomes the one the next frame reprojects
+		void EndFrame();
+
+		// Planar color of the new history, valid until EndFrame
+		const float* GetRed() const { return m_History[m_Current].data(); }
+		const float* GetGreen() const { return GetRed() + m_Size; }
+		const float* GetBlue() const { return GetGreen() + m_Size; }
+
+	private:
+		// Falloff of the weight of a new sample with its squared distance in output pixels, a Gaussian with a half pixel sigma
+		static constexpr float m_SampleSharpness{ 2.f };
+		// A pixel never holds more than this many ideal samples, so history keeps fading out and follows lighting changes
+		// Higher barely helps still images and leaves a trail of old shading on moving ones
+		static constexpr float m_MaxHistoryWeight{ 3.f };
+
+		// Input column whose sample is nearest to an output column, and the weight that distance gives the sample
+		// The jitter is the same for the whole frame, so every row shares them
+		struct Column
+		{
+			int sampleX{};
+			float weight{};
+		};
+
+		Input m_Input{};
+		std::vector<Column> m_Columns{};
+
+		// Red, green, blue and the accumulated sample weight, each a plane of width * height, one to read and one to write
+		std::vector<float> m_History[2]{};
+		int m_Current{};
+		int m_Width{};
+		int m_Height{};
+		int m_Size{};
+		bool m_IsHistoryValid{};
+	};
+}
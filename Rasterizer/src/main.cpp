@@ -5,14 +5,390 @@
 #undef main
 
 //Standard includes
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 //Project includes
+#include "Benchmark.h"
+#include "MicroBenchmarks.h"
+#include "Profiler.h"
+#include "RegressionSuite.h"
 #include "Timer.h"
 #include "Renderer.h"
 
 using namespace dae;
 
+struct CommandLineOptions
+{
+	bool isHeadless{ false };
+	bool isPipelined{ false };
+	bool cullBackfaces{ false };
+	bool isOcclusionCulling{ false };
+	bool isLodSelection{ true };
+	bool isTemporalUpsampling{ false };
+	bool isMultisampling{ false };
+	Renderer::ShadingRateSource shadingRateSource{ Renderer::ShadingRateSource::Off };
+	int width{ 640 };
+	int height{ 480 };
+	int numFrames{ 1 };
+	float timeStep{ 1.f / 60.f };
+	// Dynamic resolution is off without a target, the scale is where it starts
+	float frameTimeTarget{};
+	float resolutionScale{ 1.f };
+	std::string outputPrefix{ "Rasterizer_Headless" };
+
+	// Benchmark report is only written when a path is given
+	std::string benchmarkPath{};
+	int numWarmupFrames{ 5 };
+
+	// Profiler trace is only recorded when a path is given
+	std::string tracePath{};
+	int traceInterval{ 1 };
+
+	bool isRegression{ false };
+	RegressionSuite::Settings regression{};
+
+	bool isMicroBenchmark{ false };
+	std::string microBenchmarkFilter{};
+
+	SceneDescription scene{};
+};
+
+void PrintUsage()
+{
+	std::cout << "Usage: Rasterizer [--headless] [--width <px>] [--height <px>] [--frames <count>] [--timestep <sec>]\n"
+		<< "                  [--mesh <obj>] [--diffuse <png>] [--gloss <png>] [--normal <png>] [--specular <png>]\n"
+		<< "                  [--camera <x> <y> <z>] [--fov <degrees>] [--instances <count>] [--output <prefix>]\n"
+		<< "                  [--benchmark <report.json>] [--warmup <count>] [--trace <trace.json>] [--trace-interval <frames>] [--pipelined]\n"
+		<< "                  [--cull-backfaces] [--occlusion-culling] [--no-lod] [--frame-time-target <ms>]\n"
+		<< "                  [--resolution-scale <fraction>] [--temporal] [--msaa]\n"
+		<< "                  [--shading-rate <off|content|foveated>]\n"
+		<< "       Rasterizer --regression [--update-references] [--budget-margin <fraction>]\n"
+		<< "       Rasterizer --microbench [<name filter>]\n"
+		<< "Headless mode renders --frames frames at a fixed --timestep and writes <prefix>_<frame>.bmp\n"
+		<< "Benchmark mode renders --warmup + --frames frames at a fixed --timestep without input and writes timings as JSON\n"
+		<< "Trace records profiler zones of every Nth frame as a Chrome/Perfetto trace\n"
+		<< "Pipelined builds the next frame while the previous one rasterizes, more throughput for up to a frame more latency\n"
+		<< "Instances draws the mesh that many times in a grid, all copies share one set of vertices\n"
+		<< "Cull backfaces drops clusters and triangles facing away from the camera instead of drawing them two-sided\n"
+		<< "Occlusion culling skips instances hidden behind the ones covering the most of the screen\n"
+		<< "Frame time target lowers the internal resolution while frames take longer and upscales the result to the window\n"
+		<< "Temporal jitters every frame and accumulates them at the window resolution, for near native quality at a lower resolution scale\n"
+		<< "MSAA tests coverage and depth at 4 samples per pixel and shades once per pixel, for antialiased edges\n"
+		<< "Shading rate shades 2x2 or 4x4 pixel blocks of tiles that were flat last frame (content) or far from the center (foveated) once\n"
+		<< "Regression renders fixed scenes and checks them against the images and frame time budgets in Resources/Regression" << std::endl;
+}
+
+// Rows of tinted copies going away from the camera, sized for the vehicle
+std::vector<MeshInstance> CreateInstanceGrid(int numInstances)
+{
+	const ColorRGB tints[]
+	{
+		colors::White,
+		{ 1.f, .35f, .3f },
+		{ .4f, .6f, 1.f },
+		{ .45f, .9f, .45f },
+		{ 1.f, .85f, .3f },
+	};
+	constexpr float spacingX{ 44.f };
+	constexpr float spacingZ{ 40.f };
+
+	const int numColumns{ static_cast<int>(std::ceil(std::sqrt(static_cast<float>(numInstances)))) };
+	std::vector<MeshInstance> instances{};
+	for (int index{}; index < numInstances; ++index)
+	{
+		const int column{ index % numColumns };
+		const int row{ index / numColumns };
+		const float x{ (static_cast<float>(column) - static_cast<float>(numColumns - 1) * .5f) * spacingX };
+
+		instances.push_back({ Matrix::CreateTranslation(x, 0.f, static_cast<float>(row) * spacingZ), tints[index % std::size(tints)] });
+	}
+
+	return instances;
+}
+
+bool ParseCommandLine(int argc, char* args[], CommandLineOptions& options)
+{
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		const int numValues{ argc - i - 1 };
+
+		// std::stoi and std::stof throw on values that are not numbers or do not fit
+		try
+		{
+			if (arg == "--headless")
+				options.isHeadless = true;
+			else if (arg == "--pipelined")
+				options.isPipelined = true;
+			else if (arg == "--cull-backfaces")
+				options.cullBackfaces = true;
+			else if (arg == "--occlusion-culling")
+				options.isOcclusionCulling = true;
+			else if (arg == "--no-lod")
+				options.isLodSelection = false;
+			else if (arg == "--temporal")
+				options.isTemporalUpsampling = true;
+			else if (arg == "--msaa")
+				options.isMultisampling = true;
+			else if (arg == "--width" && numValues >= 1)
+				options.width = std::stoi(args[++i]);
+			else if (arg == "--height" && numValues >= 1)
+				options.height = std::stoi(args[++i]);
+			else if (arg == "--frames" && numValues >= 1)
+				options.numFrames = std::stoi(args[++i]);
+			else if (arg == "--timestep" && numValues >= 1)
+				options.timeStep = std::stof(args[++i]);
+			else if (arg == "--frame-time-target" && numValues >= 1)
+				options.frameTimeTarget = std::stof(args[++i]);
+			else if (arg == "--resolution-scale" && numValues >= 1)
+				options.resolutionScale = std::stof(args[++i]);
+			else if (arg == "--shading-rate" && numValues >= 1)
+			{
+				const std::string source{ args[++i] };
+				if (source == "off")
+					options.shadingRateSource = Renderer::ShadingRateSource::Off;
+				else if (source == "content")
+					options.shadingRateSource = Renderer::ShadingRateSource::Content;
+				else if (source == "foveated")
+					options.shadingRateSource = Renderer::ShadingRateSource::Foveated;
+				else
+				{
+					std::cout << "Unknown shading rate source: " << source << std::endl;
+					return false;
+				}
+			}
+			else if (arg == "--mesh" && numValues >= 1)
+				options.scene.meshPath = args[++i];
+			else if (arg == "--diffuse" && numValues >= 1)
+				options.scene.diffusePath = args[++i];
+			else if (arg == "--gloss" && numValues >= 1)
+				options.scene.glossPath = args[++i];
+			else if (arg == "--normal" && numValues >= 1)
+				options.scene.normalPath = args[++i];
+			else if (arg == "--specular" && numValues >= 1)
+				options.scene.specularPath = args[++i];
+			else if (arg == "--fov" && numValues >= 1)
+				options.scene.fovAngle = std::stof(args[++i]);
+			else if (arg == "--instances" && numValues >= 1)
+				options.scene.instances = CreateInstanceGrid(std::stoi(args[++i]));
+			else if (arg == "--output" && numValues >= 1)
+				options.outputPrefix = args[++i];
+			else if (arg == "--benchmark" && numValues >= 1)
+				options.benchmarkPath = args[++i];
+			else if (arg == "--warmup" && numValues >= 1)
+				options.numWarmupFrames = std::stoi(args[++i]);
+			else if (arg == "--trace" && numValues >= 1)
+				options.tracePath = args[++i];
+			else if (arg == "--trace-interval" && numValues >= 1)
+				options.traceInterval = std::stoi(args[++i]);
+			else if (arg == "--regression")
+				options.isRegression = true;
+			else if (arg == "--update-references")
+				options.regression.updateReferences = true;
+			else if (arg == "--budget-margin" && numValues >= 1)
+				options.regression.budgetMargin = std::stof(args[++i]);
+			else if (arg == "--microbench")
+			{
+				options.isMicroBenchmark = true;
+				if (numValues >= 1 && std::string{ args[i + 1] }.rfind("--", 0) != 0)
+					options.microBenchmarkFilter = args[++i];
+			}
+			else if (arg == "--camera" && numValues >= 3)
+			{
+				options.scene.cameraOrigin.x = std::stof(args[++i]);
+				options.scene.cameraOrigin.y = std::stof(args[++i]);
+				options.scene.cameraOrigin.z = std::stof(args[++i]);
+			}
+			else
+			{
+				std::cout << "Unknown or incomplete argument: " << arg << std::endl;
+				return false;
+			}
+		}
+		catch (const std::logic_error&)
+		{
+			std::cout << "Invalid value for " << arg << std::endl;
+			return false;
+		}
+	}
+
+	return options.width > 0 && options.height > 0 && options.numFrames > 0 && options.traceInterval > 0 && !options.scene.instances.empty();
+}
+
+std::string EscapeJson(const std::string& text)
+{
+	std::string escaped{};
+	for (const char c : text)
+	{
+		if (c == '\\' || c == '"')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+bool FinishBenchmark(const CommandLineOptions& options, const Benchmark& benchmark)
+{
+	const std::string config{ "{ \"mode\": \"" + std::string{ options.isHeadless ? "headless" : "windowed" }
+		+ "\", \"width\": " + std::to_string(options.width)
+		+ ", \"height\": " + std::to_string(options.height)
+		+ ", \"timestep\": " + std::to_string(options.timeStep)
+		+ ", \"pipelined\": " + (options.isPipelined ? "true" : "false")
+		+ ", \"cullBackfaces\": " + (options.cullBackfaces ? "true" : "false")
+		+ ", \"occlusionCulling\": " + (options.isOcclusionCulling ? "true" : "false")
+		+ ", \"lodSelection\": " + (options.isLodSelection ? "true" : "false")
+		+ ", \"frameTimeTarget\": " + std::to_string(options.frameTimeTarget)
+		+ ", \"resolutionScale\": " + std::to_string(options.resolutionScale)
+		+ ", \"temporalUpsampling\": " + (options.isTemporalUpsampling ? "true" : "false")
+		+ ", \"multisampling\": " + (options.isMultisampling ? "true" : "false")
+		+ ", \"shadingRate\": \"" + (options.shadingRateSource == Renderer::ShadingRateSource::Content ? "content"
+			: (options.shadingRateSource == Renderer::ShadingRateSource::Foveated ? "foveated" : "off")) + "\""
+		+ ", \"instances\": " + std::to_string(options.scene.instances.size())
+		+ ", \"mesh\": \"" + EscapeJson(options.scene.meshPath) + "\" }" };
+
+	benchmark.PrintSummary();
+	if (!benchmark.WriteJson(options.benchmarkPath, config))
+	{
+		std::cout << "Failed to write benchmark report " << options.benchmarkPath << "!" << std::endl;
+		return false;
+	}
+
+	std::cout << "Benchmark report written to " << options.benchmarkPath << std::endl;
+	return true;
+}
+
+void PrintPipelineStatistics(const PipelineStatistics& statistics)
+{
+	std::cout << "Pipeline statistics:\n"
+		<< "  instances submitted: " << statistics.instancesSubmitted << ", culled: " << statistics.instancesCulled
+		<< ", occluded: " << statistics.instancesOccluded << ", too small: " << statistics.instancesTooSmall << "\n"
+		<< "  clusters submitted: " << statistics.clustersSubmitted << ", culled: " << statistics.clustersCulled << "\n"
+		<< "  vertices transformed: " << statistics.verticesTransformed << "\n"
+		<< "  triangles submitted: " << statistics.trianglesSubmitted << ", culled: " << statistics.trianglesCulled
+		<< ", clipped: " << statistics.trianglesClipped << ", rasterized: " << statistics.trianglesRasterized << "\n"
+		<< "  pixels tested: " << statistics.pixelsTested << ", depth passed: " << statistics.pixelsDepthPassed
+		<< ", shaded: " << statistics.pixelsShaded << "\n"
+		<< "  texture fetches: " << statistics.textureFetches << std::endl;
+}
+
+void PrintArenaStatistics(const ArenaStatistics& statistics)
+{
+	std::cout << "Frame arena: " << statistics.used / 1024 << " KiB used, high-water " << statistics.highWater / 1024
+		<< " KiB, capacity " << statistics.capacity / 1024 << " KiB, " << statistics.numOverflows << " overflow(s)" << std::endl;
+}
+
+void StartTrace(const CommandLineOptions& options)
+{
+	// Before the renderer is created, so mesh and texture loading end up in the trace
+	if (!options.tracePath.empty())
+		Profiler::GetInstance().SetSampleInterval(options.traceInterval);
+}
+
+bool FinishTrace(const CommandLineOptions& options)
+{
+	if (options.tracePath.empty())
+		return true;
+
+	if (!Profiler::GetInstance().ExportChromeTrace(options.tracePath))
+	{
+		std::cout << "Failed to write trace " << options.tracePath << "!" << std::endl;
+		return false;
+	}
+
+	std::cout << "Trace written to " << options.tracePath << std::endl;
+	return true;
+}
+
+int RunHeadless(const CommandLineOptions& options)
+{
+	//No SDL_Init, surfaces, image loading and the performance counter work without the video subsystem
+	const auto pTimer = new Timer();
+	StartTrace(options);
+	const auto pRenderer = new Renderer(options.width, options.height, options.scene);
+	if (!pRenderer->IsLoaded())
+	{
+		delete pRenderer;
+		delete pTimer;
+		FinishTrace(options);
+		return 1;
+	}
+
+	const bool isBenchmark{ !options.benchmarkPath.empty() };
+	Benchmark benchmark{ options.numFrames, options.numWarmupFrames };
+	pRenderer->SetCollectTimings(isBenchmark);
+	pRenderer->SetPipelined(options.isPipelined);
+	pRenderer->SetBackfaceCulling(options.cullBackfaces);
+	pRenderer->SetOcclusionCulling(options.isOcclusionCulling);
+	pRenderer->SetLodSelection(options.isLodSelection);
+	pRenderer->SetFrameTimeTarget(options.frameTimeTarget);
+	pRenderer->SetResolutionScale(options.resolutionScale);
+	pRenderer->SetTemporalUpsampling(options.isTemporalUpsampling);
+	pRenderer->SetMultisampling(options.isMultisampling);
+	pRenderer->SetShadingRateSource(options.shadingRateSource);
+
+	pTimer->Start();
+
+	int exitCode{ 0 };
+	const int numFrames{ isBenchmark ? options.numWarmupFrames + options.numFrames : options.numFrames };
+	const double msPerCount{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) };
+	for (int frame{}; frame < numFrames; ++frame)
+	{
+		const uint64_t frameStart{ SDL_GetPerformanceCounter() };
+
+		pRenderer->Update(options.timeStep);
+		pRenderer->Render();
+
+		// The fixed timestep drives the scene, the measured frame times drive the resolution
+		pTimer->Update();
+		pRenderer->UpdateResolutionScale(pTimer);
+
+		if (isBenchmark)
+		{
+			//No image output, it would only measure the disk
+			benchmark.AddFrame(static_cast<double>(SDL_GetPerformanceCounter() - frameStart) * msPerCount, pRenderer->GetFrameTimings());
+			continue;
+		}
+
+		char frameSuffix[16]{};
+		snprintf(frameSuffix, sizeof(frameSuffix), "_%04d.bmp", frame);
+
+		const std::string path{ options.outputPrefix + frameSuffix };
+		if (pRenderer->SaveBufferToImage(path))
+		{
+			std::cout << "Failed to save " << path << "!" << std::endl;
+			exitCode = 1;
+			break;
+		}
+	}
+
+	pRenderer->Flush();
+	pTimer->Update();
+	pTimer->Stop();
+
+	std::cout << "Rendered " << numFrames << " frame(s) at " << options.width << "x" << options.height
+		<< " in " << pTimer->GetTotal() << "s" << std::endl;
+	if (options.frameTimeTarget > 0.f || options.resolutionScale < 1.f)
+		std::cout << "Resolution scale " << pRenderer->GetResolutionScale()
+			<< (options.frameTimeTarget > 0.f ? " for a " + std::to_string(options.frameTimeTarget) + "ms target" : std::string{}) << std::endl;
+	PrintPipelineStatistics(pRenderer->GetPipelineStatistics());
+	PrintArenaStatistics(pRenderer->GetArenaStatistics());
+
+	if (isBenchmark && !FinishBenchmark(options, benchmark))
+		exitCode = 1;
+
+	delete pRenderer;
+	delete pTimer;
+
+	if (!FinishTrace(options))
+		exitCode = 1;
+
+	return exitCode;
+}
+
 void ShutDown(SDL_Window* pWindow)
 {
 	SDL_DestroyWindow(pWindow);
@@ -21,15 +397,27 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	CommandLineOptions options{};
+	if (!ParseCommandLine(argc, args, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (options.isMicroBenchmark)
+		return MicroBenchmarks{ options.microBenchmarkFilter }.Run();
+
+	if (options.isRegression)
+		return RegressionSuite{ options.regression }.Run() == 0 ? 0 : 1;
+
+	if (options.isHeadless)
+		return RunHeadless(options);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	constexpr uint32_t width = 640;
-	constexpr uint32_t height = 480;
+	const int width = options.width;
+	const int height = options.height;
 
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"Rasterizer - **Van Hoorebeke Tibo (2DAE10)**",
@@ -42,13 +430,35 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	StartTrace(options);
+	const auto pRenderer = new Renderer(pWindow, options.scene);
+	if (!pRenderer->IsLoaded())
+	{
+		delete pRenderer;
+		delete pTimer;
+		FinishTrace(options);
+		ShutDown(pWindow);
+		return 1;
+	}
 
 	//Start loop
 	pTimer->Start();
 
-	// Start Benchmark
-	// TODO pTimer->StartBenchmark();
+	// Start Benchmark, fixed timestep and no camera input so runs are reproducible
+	const bool isBenchmark{ !options.benchmarkPath.empty() };
+	Benchmark benchmark{ options.numFrames, options.numWarmupFrames };
+	pRenderer->SetCollectTimings(isBenchmark);
+	pRenderer->SetInputEnabled(!isBenchmark);
+	pRenderer->SetPipelined(options.isPipelined);
+	pRenderer->SetBackfaceCulling(options.cullBackfaces);
+	pRenderer->SetOcclusionCulling(options.isOcclusionCulling);
+	pRenderer->SetLodSelection(options.isLodSelection);
+	pRenderer->SetFrameTimeTarget(options.frameTimeTarget);
+	pRenderer->SetResolutionScale(options.resolutionScale);
+	pRenderer->SetTemporalUpsampling(options.isTemporalUpsampling);
+	pRenderer->SetMultisampling(options.isMultisampling);
+	pRenderer->SetShadingRateSource(options.shadingRateSource);
+	const double msPerCount{ 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency()) };
 
 	float printTimer = 0.f;
 	bool isLooping = true;
@@ -74,6 +484,15 @@ int main(int argc, char* args[])
 				case SDL_SCANCODE_ESCAPE:
 					isLooping = false;
 					break;
+				case SDL_SCANCODE_F1:
+					pRenderer->ToggleLodSelection();
+					break;
+				case SDL_SCANCODE_F2:
+					pRenderer->ToggleOcclusionCulling();
+					break;
+				case SDL_SCANCODE_F3:
+					pRenderer->ToggleBackfaceCulling();
+					break;
 				case SDL_SCANCODE_F4:
 					pRenderer->ToggleDepthBuffer();
 					break;
@@ -86,17 +505,60 @@ int main(int argc, char* args[])
 				case SDL_SCANCODE_F6:
 					pRenderer->ToggleUseNormals();
 					break;
+				case SDL_SCANCODE_F9:
+					pRenderer->CycleDepthFormat();
+					break;
+				case SDL_SCANCODE_F8:
+					pRenderer->CycleToneMapping();
+					break;
+				case SDL_SCANCODE_F10:
+					pRenderer->ToggleOverdrawView();
+					break;
+				case SDL_SCANCODE_F11:
+					PrintPipelineStatistics(pRenderer->GetPipelineStatistics());
+					PrintArenaStatistics(pRenderer->GetArenaStatistics());
+					break;
+				case SDL_SCANCODE_F12:
+					pRenderer->ToggleTemporalUpsampling();
+					break;
+				case SDL_SCANCODE_M:
+					pRenderer->ToggleMultisampling();
+					break;
+				case SDL_SCANCODE_N:
+					pRenderer->CycleShadingRateSource();
+					break;
+				case SDL_SCANCODE_KP_PLUS:
+					pRenderer->ChangeExposure(.5f);
+					break;
+				case SDL_SCANCODE_KP_MINUS:
+					pRenderer->ChangeExposure(-.5f);
+					break;
 				}
 				break;
 			}
 		}
 
+		const uint64_t frameStart{ SDL_GetPerformanceCounter() };
+
 		//--------- Update ---------
-		pRenderer->Update(pTimer);
+		if (isBenchmark)
+		{
+			pRenderer->Update(options.timeStep);
+			pRenderer->UpdateResolutionScale(pTimer);
+		}
+		else
+			pRenderer->Update(pTimer);
 
 		//--------- Render ---------
 		pRenderer->Render();
 
+		if (isBenchmark)
+		{
+			benchmark.AddFrame(static_cast<double>(SDL_GetPerformanceCounter() - frameStart) * msPerCount, pRenderer->GetFrameTimings());
+			if (benchmark.IsDone())
+				isLooping = false;
+		}
+
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
@@ -116,12 +578,20 @@ int main(int argc, char* args[])
 			takeScreenshot = false;
 		}
 	}
+	pRenderer->Flush();
 	pTimer->Stop();
 
+	int exitCode{ 0 };
+	if (isBenchmark && !FinishBenchmark(options, benchmark))
+		exitCode = 1;
+
 	//Shutdown "framework"
 	delete pRenderer;
 	delete pTimer;
 
+	if (!FinishTrace(options))
+		exitCode = 1;
+
 	ShutDown(pWindow);
-	return 0;
+	return exitCode;
 }
\ No newline at end of file
@@ -1,5 +1,24 @@
 #include "gtest/gtest.h"
+#include "BoundingBox.h"
+#include "Bvh.h"
+#include "FrameArena.h"
+#include "Frustum.h"
+#include "JobSystem.h"
 #include "Maths.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "SpscQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
 
 
 namespace dae
@@ -9,4 +28,953 @@ namespace dae
 		EXPECT_TRUE(true);
 	}
 
+	namespace
+	{
+		// Scalar TransformPoint(Vector4) as it was before the SSE kernels, in the same summation order
+		Vector4 ScalarTransformPoint(const Matrix& m, const Vector4& p)
+		{
+			return Vector4{
+				m[0].x * p.x + m[1].x * p.y + m[2].x * p.z + m[3].x,
+				m[0].y * p.x + m[1].y * p.y + m[2].y * p.z + m[3].y,
+				m[0].z * p.x + m[1].z * p.y + m[2].z * p.z + m[3].z,
+				m[0].w * p.x + m[1].w * p.y + m[2].w * p.z + m[3].w
+			};
+		}
+
+		void ExpectBitwiseEqual(const Vector4& actual, const Vector4& expected)
+		{
+			for (int i{}; i < 4; ++i)
+				EXPECT_EQ(actual[i], expected[i]) << "component " << i;
+		}
+
+		void ExpectNear(const Matrix& actual, const Matrix& expected, float tolerance)
+		{
+			for (int r{}; r < 4; ++r)
+			{
+				for (int c{}; c < 4; ++c)
+					EXPECT_NEAR(actual[r][c], expected[r][c], tolerance) << "row " << r << ", column " << c;
+			}
+		}
+
+		// Rotation, non-uniform scale and translation, so every element takes part
+		Matrix CreateTestWorldMatrix()
+		{
+			return Matrix::CreateScale(1.5f, .75f, 2.f) * Matrix::CreateRotation(.3f, -1.1f, .7f) * Matrix::CreateTranslation(4.f, -2.5f, 10.f);
+		}
+	}
+
+	TEST(MatrixSimd, MultiplyMatchesConstantEvaluation)
+	{
+		constexpr Matrix a{ Vector4{ 1.f, 2.f, -3.f, .5f }, Vector4{ .25f, -1.f, 4.f, 2.f }, Vector4{ 3.f, .1f, 1.f, -2.f }, Vector4{ -.5f, 6.f, 2.f, 1.f } };
+		constexpr Matrix b{ Vector4{ .3f, -2.f, 1.f, 0.f }, Vector4{ 1.f, 1.f, .7f, 3.f }, Vector4{ -4.f, .2f, 2.f, 1.f }, Vector4{ 5.f, -1.f, .5f, 1.f } };
+		constexpr Matrix expected{ a * b };
+
+		const Matrix actual{ a * b };
+		for (int r{}; r < 4; ++r)
+			ExpectBitwiseEqual(actual[r], expected[r]);
+	}
+
+	TEST(MatrixSimd, InverseTimesMatrixIsIdentity)
+	{
+		const Matrix identity{ Matrix::CreateScale(1.f, 1.f, 1.f) };
+
+		const Matrix world{ CreateTestWorldMatrix() };
+		ExpectNear(world * Matrix::Inverse(world), identity, 1e-5f);
+		ExpectNear(Matrix::Inverse(world) * world, identity, 1e-5f);
+
+		// Full 4x4 with a projection, the last column is not (0, 0, 0, 1)
+		const Matrix worldViewProjection{ world * Matrix::CreatePerspectiveFovLH(.8f, 4.f / 3.f, .1f, 100.f) };
+		ExpectNear(worldViewProjection * Matrix::Inverse(worldViewProjection), identity, 1e-4f);
+	}
+
+	TEST(MatrixSimd, InverseAffineMatchesInverse)
+	{
+		const Matrix world{ Matrix::CreateRotation(-.4f, 2.2f, .9f) * Matrix::CreateTranslation(-7.f, 3.f, 12.5f) };
+		const Matrix inverse{ Matrix::InverseAffine(world) };
+
+		ExpectNear(world * inverse, Matrix::CreateScale(1.f, 1.f, 1.f), 1e-5f);
+		ExpectNear(inverse, Matrix::Inverse(world), 1e-5f);
+
+		// Undoes the rotation and the translation of a point
+		const Vector3 point{ 1.f, -2.f, 3.f };
+		const Vector3 roundTrip{ inverse.TransformPoint(world.TransformPoint(point)) };
+		EXPECT_NEAR(roundTrip.x, point.x, 1e-5f);
+		EXPECT_NEAR(roundTrip.y, point.y, 1e-5f);
+		EXPECT_NEAR(roundTrip.z, point.z, 1e-5f);
+	}
+
+	TEST(MatrixSimd, TransformPointMatchesScalar)
+	{
+		constexpr Matrix m{ Vector4{ 1.f, 2.f, -3.f, .5f }, Vector4{ .25f, -1.f, 4.f, 2.f }, Vector4{ 3.f, .1f, 1.f, -2.f }, Vector4{ -.5f, 6.f, 2.f, 1.f } };
+		constexpr Vector4 point{ .7f, -1.3f, 2.9f, 1.f };
+		constexpr Vector4 expected{ m.TransformPoint(point) };
+
+		ExpectBitwiseEqual(m.TransformPoint(point), expected);
+		ExpectBitwiseEqual(ScalarTransformPoint(m, point), expected);
+	}
+
+	TEST(MatrixSimd, TransformPointsMatchesTransformPoint)
+	{
+		const Matrix m{ CreateTestWorldMatrix() * Matrix::CreatePerspectiveFovLH(.8f, 4.f / 3.f, .1f, 100.f) };
+
+		// The vertex stage hands over chunks of 256 points, the last one usually shorter
+		for (const size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ 3 }, size_t{ 255 }, size_t{ 257 }, size_t{ 1000 } })
+		{
+			std::vector<Vector4> points(count);
+			for (size_t i{}; i < count; ++i)
+			{
+				const float t{ static_cast<float>(i) };
+				points[i] = { std::sin(t) * 10.f, std::cos(t * .7f) * 5.f, t * .01f - 3.f, 1.f };
+			}
+
+			std::vector<Vector4> transformed(count);
+			m.TransformPoints(points, transformed);
+
+			for (size_t i{}; i < count; ++i)
+			{
+				SCOPED_TRACE(testing::Message() << count << " points, point " << i);
+				ExpectBitwiseEqual(transformed[i], m.TransformPoint(points[i]));
+				ExpectBitwiseEqual(transformed[i], ScalarTransformPoint(m, points[i]));
+			}
+		}
+	}
+
+	namespace
+	{
+		// 90 degree perspective looking down +z from the origin, the planes are x = +-z, y = +-z, z = .1 and z = 100
+		Matrix CreateTestProjectionMatrix()
+		{
+			return Matrix::CreatePerspectiveFovLH(1.f, 1.f, .1f, 100.f);
+		}
+
+		BoundingBox CreateBox(const Vector3& center, const Vector3& extents)
+		{
+			return { center - extents, center + extents };
+		}
+
+		// Boxes of mixed sizes spread around the camera, so some end up inside, some across a plane and some outside
+		std::vector<BoundingBox> CreateRandomBoxes(std::mt19937& random, int count)
+		{
+			std::uniform_real_distribution<float> position{ -60.f, 60.f };
+			std::uniform_real_distribution<float> extent{ .1f, 8.f };
+
+			std::vector<BoundingBox> boxes{};
+			for (int index{}; index < count; ++index)
+				boxes.push_back(CreateBox({ position(random), position(random), position(random) }, { extent(random), extent(random), extent(random) }));
+			return boxes;
+		}
+
+		std::vector<int> QueryBvh(const Bvh& bvh, const Frustum& frustum)
+		{
+			std::vector<int> indices{};
+			bvh.Query(frustum, [&indices](int index) { indices.push_back(index); });
+			std::sort(indices.begin(), indices.end());
+			return indices;
+		}
+
+		std::vector<int> QueryBruteForce(std::span<const BoundingBox> boxes, const Frustum& frustum)
+		{
+			std::vector<int> indices{};
+			for (int index{}; index < static_cast<int>(boxes.size()); ++index)
+			{
+				if (frustum.Test(boxes[index]) != Frustum::Containment::Outside)
+					indices.push_back(index);
+			}
+			return indices;
+		}
+	}
+
+	TEST(Frustum, ClassifiesKnownBoxes)
+	{
+		const Frustum frustum{ CreateTestProjectionMatrix() };
+
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 0.f, 10.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Inside);
+		EXPECT_EQ(frustum.Test(CreateBox({ 3.f, -2.f, 50.f }, { 5.f, 5.f, 5.f })), Frustum::Containment::Inside);
+
+		// Across the right plane, the near plane and the far plane
+		EXPECT_EQ(frustum.Test(CreateBox({ 10.f, 0.f, 10.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Intersecting);
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 0.f, 0.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Intersecting);
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 0.f, 100.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Intersecting);
+
+		// Behind the camera, beside it, above it and past the far plane
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 0.f, -5.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Outside);
+		EXPECT_EQ(frustum.Test(CreateBox({ -20.f, 0.f, 10.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Outside);
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 20.f, 10.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Outside);
+		EXPECT_EQ(frustum.Test(CreateBox({ 0.f, 0.f, 110.f }, { 1.f, 1.f, 1.f })), Frustum::Containment::Outside);
+	}
+
+	TEST(BoundingBox, TransformedMatchesBoxAroundTransformedCorners)
+	{
+		const BoundingBox box{ Vector3{ -1.f, .5f, 2.f }, Vector3{ 3.f, 1.5f, 2.25f } };
+		const Matrix world{ CreateTestWorldMatrix() };
+
+		BoundingBox expected{};
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Vector3 point{ corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z };
+			expected.Grow(world.TransformPoint(point));
+		}
+
+		const BoundingBox actual{ box.Transformed(world) };
+		for (int axis{}; axis < 3; ++axis)
+		{
+			EXPECT_NEAR(actual.min[axis], expected.min[axis], 1e-4f) << "axis " << axis;
+			EXPECT_NEAR(actual.max[axis], expected.max[axis], 1e-4f) << "axis " << axis;
+		}
+
+		EXPECT_TRUE(BoundingBox{}.Transformed(world).IsEmpty());
+	}
+
+	TEST(Bvh, QueryMatchesBruteForce)
+	{
+		std::mt19937 random{ 1234 };
+		std::vector<BoundingBox> boxes{ CreateRandomBoxes(random, 1000) };
+
+		// Straight ahead and turned away from the origin, so whole subtrees end up on either side
+		const Frustum frustums[]{
+			Frustum{ CreateTestProjectionMatrix() },
+			Frustum{ Matrix::InverseAffine(Matrix::CreateRotation(.4f, 2.5f, .1f) * Matrix::CreateTranslation(10.f, -5.f, 20.f)) * CreateTestProjectionMatrix() }
+		};
+
+		Bvh bvh{};
+		bvh.Build(boxes);
+		for (const Frustum& frustum : frustums)
+			EXPECT_EQ(QueryBvh(bvh, frustum), QueryBruteForce(boxes, frustum));
+
+		// Move every box without rebuilding, the tree gets looser but the results must not change
+		std::uniform_real_distribution<float> offset{ -15.f, 15.f };
+		for (BoundingBox& box : boxes)
+		{
+			const Vector3 translation{ offset(random), offset(random), offset(random) };
+			box = { box.min + translation, box.max + translation };
+		}
+
+		bvh.Refit(boxes);
+		for (const Frustum& frustum : frustums)
+			EXPECT_EQ(QueryBvh(bvh, frustum), QueryBruteForce(boxes, frustum));
+
+		// Something has to land on both sides, or the comparison proves nothing
+		const std::vector<int> visible{ QueryBruteForce(boxes, frustums[0]) };
+		EXPECT_FALSE(visible.empty());
+		EXPECT_LT(visible.size(), boxes.size());
+	}
+
+	TEST(Bvh, EmptyQueryVisitsNothing)
+	{
+		Bvh bvh{};
+		bvh.Build({});
+		EXPECT_TRUE(QueryBvh(bvh, Frustum{ CreateTestProjectionMatrix() }).empty());
+	}
+
+	namespace
+	{
+		// Two triangles per quad of a grid in the xy plane, facing +z, with z displaced by height(x, y)
+		// Unshared gives every triangle its own three vertices, at the same positions
+		template<typename Height>
+		Mesh CreateGridMesh(int numQuadsX, int numQuadsY, const Height& height, bool isUnshared = false)
+		{
+			Mesh mesh{};
+			const auto getPosition = [&](int x, int y)
+				{
+					const float fx{ static_cast<float>(x) };
+					const float fy{ static_cast<float>(y) };
+					return Vector4{ fx, fy, height(fx, fy), 1.f };
+				};
+
+			if (!isUnshared)
+			{
+				for (int y{}; y <= numQuadsY; ++y)
+				{
+					for (int x{}; x <= numQuadsX; ++x)
+						mesh.vertices.push_back({ getPosition(x, y) });
+				}
+			}
+
+			const auto addCorner = [&](int x, int y)
+				{
+					if (isUnshared)
+					{
+						mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+						mesh.vertices.push_back({ getPosition(x, y) });
+					}
+					else
+						mesh.indices.push_back(static_cast<uint32_t>(y * (numQuadsX + 1) + x));
+				};
+
+			for (int y{}; y < numQuadsY; ++y)
+			{
+				for (int x{}; x < numQuadsX; ++x)
+				{
+					addCorner(x, y); addCorner(x + 1, y); addCorner(x, y + 1);
+					addCorner(x + 1, y); addCorner(x + 1, y + 1); addCorner(x, y + 1);
+				}
+			}
+			return mesh;
+		}
+
+		Vector3 GetMeshletPosition(const Mesh& mesh, const MeshLod& lod, const Meshlet& meshlet, uint8_t vertex)
+		{
+			return Vector3{ mesh.vertices[lod.meshletVertices[meshlet.firstVertex + vertex]].position };
+		}
+
+		// Limits, layout and bounds of every meshlet, and that together they hold every triangle of mesh exactly once
+		void ExpectValidMeshlets(const Mesh& mesh, const MeshLod& lod)
+		{
+			const size_t numTriangles{ mesh.indices.size() / 3 };
+			ASSERT_EQ(lod.numTriangles, numTriangles);
+			ASSERT_EQ(lod.meshletTriangles.size(), numTriangles * 3);
+
+			// Triangles are identified by their indices, in their original corner order, so a changed winding shows up as missing
+			std::map<std::array<uint32_t, 3>, size_t> triangleIds{};
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+				triangleIds.emplace(std::array<uint32_t, 3>{ mesh.indices[triangle * 3], mesh.indices[triangle * 3 + 1], mesh.indices[triangle * 3 + 2] }, triangle);
+			ASSERT_EQ(triangleIds.size(), numTriangles);
+
+			std::vector<int> numEmitted(numTriangles);
+			uint32_t nextVertex{};
+			uint32_t nextTriangle{};
+			for (size_t meshletIndex{}; meshletIndex < lod.meshlets.size(); ++meshletIndex)
+			{
+				SCOPED_TRACE(testing::Message() << "meshlet " << meshletIndex);
+				const Meshlet& meshlet{ lod.meshlets[meshletIndex] };
+
+				EXPECT_GT(meshlet.numTriangles, 0u);
+				EXPECT_LE(meshlet.numTriangles, MeshletBuilder::maxTriangles);
+				EXPECT_LE(meshlet.numVertices, MeshletBuilder::maxVertices);
+				EXPECT_EQ(meshlet.firstVertex, nextVertex);
+				EXPECT_EQ(meshlet.firstTriangle, nextTriangle);
+				nextVertex += meshlet.numVertices;
+				nextTriangle += meshlet.numTriangles;
+
+				// Meshlets start at the first triangle that no earlier meshlet took, so they follow the submission order
+				const auto firstUnused{ std::find(numEmitted.begin(), numEmitted.end(), 0) };
+				std::vector<size_t> meshletTriangles{};
+
+				for (uint32_t triangle{}; triangle < meshlet.numTriangles; ++triangle)
+				{
+					const uint8_t* pIndices{ lod.meshletTriangles.data() + (meshlet.firstTriangle + triangle) * 3 };
+					std::array<uint32_t, 3> indices{};
+					for (int corner{}; corner < 3; ++corner)
+					{
+						ASSERT_LT(pIndices[corner], meshlet.numVertices);
+						indices[corner] = lod.meshletVertices[meshlet.firstVertex + pIndices[corner]];
+
+						const Vector3 position{ GetMeshletPosition(mesh, lod, meshlet, pIndices[corner]) };
+						EXPECT_LE((position - meshlet.center).Magnitude(), meshlet.radius * 1.0001f + 1e-5f);
+					}
+
+					const auto id{ triangleIds.find(indices) };
+					ASSERT_NE(id, triangleIds.end()) << "triangle " << triangle << " is not one of the mesh";
+					++numEmitted[id->second];
+					meshletTriangles.push_back(id->second);
+				}
+
+				EXPECT_EQ(meshletTriangles.front(), static_cast<size_t>(firstUnused - numEmitted.begin()));
+			}
+			EXPECT_EQ(nextVertex, lod.meshletVertices.size());
+
+			for (size_t triangle{}; triangle < numTriangles; ++triangle)
+				EXPECT_EQ(numEmitted[triangle], 1) << "triangle " << triangle;
+		}
+
+		// The normal of every triangle is at most the cone half angle away from the axis
+		void ExpectNormalsInsideCones(const Mesh& mesh, const MeshLod& lod)
+		{
+			for (size_t meshletIndex{}; meshletIndex < lod.meshlets.size(); ++meshletIndex)
+			{
+				const Meshlet& meshlet{ lod.meshlets[meshletIndex] };
+				if (meshlet.coneCutoff >= 1.f)
+					continue;
+
+				EXPECT_NEAR(meshlet.coneAxis.Magnitude(), 1.f, 1e-4f) << "meshlet " << meshletIndex;
+				const float minDot{ std::sqrt(1.f - meshlet.coneCutoff * meshlet.coneCutoff) };
+				for (uint32_t triangle{}; triangle < meshlet.numTriangles; ++triangle)
+				{
+					const uint8_t* pIndices{ lod.meshletTriangles.data() + (meshlet.firstTriangle + triangle) * 3 };
+					const Vector3 p0{ GetMeshletPosition(mesh, lod, meshlet, pIndices[0]) };
+					const Vector3 p1{ GetMeshletPosition(mesh, lod, meshlet, pIndices[1]) };
+					const Vector3 p2{ GetMeshletPosition(mesh, lod, meshlet, pIndices[2]) };
+
+					const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0).Normalized() };
+					EXPECT_GE(Vector3::Dot(normal, meshlet.coneAxis), minDot - 1e-4f) << "meshlet " << meshletIndex << ", triangle " << triangle;
+				}
+			}
+		}
+	}
+
+	TEST(MeshletBuilder, GridKeepsLimitsAndEveryTriangle)
+	{
+		// Gentle waves, so most meshlets get a cone and some don't
+		const auto height = [](float x, float y) { return std::sin(x * .3f) * 2.f + std::cos(y * .2f) * 3.f; };
+
+		const Mesh mesh{ CreateGridMesh(40, 30, height) };
+		MeshLod lod{};
+		MeshletBuilder::Build(mesh.vertices, mesh.indices, lod);
+
+		// 2400 triangles need at least 19 meshlets
+		EXPECT_GE(lod.meshlets.size(), size_t{ 19 });
+		ExpectValidMeshlets(mesh, lod);
+		ExpectNormalsInsideCones(mesh, lod);
+		EXPECT_TRUE(std::any_of(lod.meshlets.begin(), lod.meshlets.end(), [](const Meshlet& meshlet) { return meshlet.coneCutoff < 1.f; }));
+	}
+
+	TEST(MeshletBuilder, UnsharedVerticesHitTheVertexLimit)
+	{
+		// Three new vertices per triangle, so meshlets fill up at 85 triangles and 255 vertices
+		const Mesh mesh{ CreateGridMesh(20, 20, [](float, float) { return 0.f; }, true) };
+		MeshLod lod{};
+		MeshletBuilder::Build(mesh.vertices, mesh.indices, lod);
+
+		ExpectValidMeshlets(mesh, lod);
+		EXPECT_TRUE(std::any_of(lod.meshlets.begin(), lod.meshlets.end(), [](const Meshlet& meshlet) { return meshlet.numVertices == MeshletBuilder::maxVertices; }));
+	}
+
+	TEST(MeshletBuilder, FlatPatchHasNarrowCone)
+	{
+		const Mesh mesh{ CreateGridMesh(6, 6, [](float, float) { return 1.f; }) };
+		MeshLod lod{};
+		MeshletBuilder::Build(mesh.vertices, mesh.indices, lod);
+
+		ASSERT_EQ(lod.meshlets.size(), size_t{ 1 });
+		ExpectValidMeshlets(mesh, lod);
+
+		// Every normal is +z, so the cone has no width at all
+		const Meshlet& meshlet{ lod.meshlets.front() };
+		EXPECT_NEAR(meshlet.coneAxis.x, 0.f, 1e-5f);
+		EXPECT_NEAR(meshlet.coneAxis.y, 0.f, 1e-5f);
+		EXPECT_NEAR(meshlet.coneAxis.z, 1.f, 1e-5f);
+		EXPECT_NEAR(meshlet.coneCutoff, 0.f, 1e-3f);
+	}
+
+	TEST(MeshletBuilder, EmptyTriangleListHasNoMeshlets)
+	{
+		MeshLod lod{};
+		MeshletBuilder::Build({}, {}, lod);
+		EXPECT_TRUE(lod.meshlets.empty());
+		EXPECT_EQ(lod.numTriangles, 0u);
+	}
+
+	namespace
+	{
+		// Closed unit sphere, every vertex shared by the triangles around it and a single vertex at each pole
+		Mesh CreateSphereMesh(int numRings, int numSegments)
+		{
+			constexpr float pi{ 3.14159265f };
+
+			Mesh mesh{};
+			const auto addVertex = [&mesh](const Vector3& position)
+				{
+					Vertex vertex{};
+					vertex.position = { position.x, position.y, position.z, 1.f };
+					vertex.normal = position;
+					mesh.vertices.push_back(vertex);
+				};
+
+			addVertex({ 0.f, 1.f, 0.f });
+			for (int ring{ 1 }; ring < numRings; ++ring)
+			{
+				const float pitch{ pi * static_cast<float>(ring) / static_cast<float>(numRings) };
+				for (int segment{}; segment < numSegments; ++segment)
+				{
+					const float yaw{ 2.f * pi * static_cast<float>(segment) / static_cast<float>(numSegments) };
+					addVertex({ std::sin(pitch) * std::cos(yaw), std::cos(pitch), std::sin(pitch) * std::sin(yaw) });
+				}
+			}
+			addVertex({ 0.f, -1.f, 0.f });
+
+			const uint32_t bottom{ static_cast<uint32_t>(mesh.vertices.size() - 1) };
+			const auto getIndex = [numSegments](int ring, int segment) { return static_cast<uint32_t>(1 + (ring - 1) * numSegments + segment % numSegments); };
+			for (int segment{}; segment < numSegments; ++segment)
+			{
+				mesh.indices.insert(mesh.indices.end(), { 0, getIndex(1, segment + 1), getIndex(1, segment) });
+				for (int ring{ 1 }; ring + 1 < numRings; ++ring)
+				{
+					mesh.indices.insert(mesh.indices.end(), { getIndex(ring, segment), getIndex(ring, segment + 1), getIndex(ring + 1, segment) });
+					mesh.indices.insert(mesh.indices.end(), { getIndex(ring, segment + 1), getIndex(ring + 1, segment + 1), getIndex(ring + 1, segment) });
+				}
+				mesh.indices.insert(mesh.indices.end(), { bottom, getIndex(numRings - 1, segment), getIndex(numRings - 1, segment + 1) });
+			}
+			return mesh;
+		}
+
+		// The triangles of every meshlet of lod as a list of mesh vertex indices
+		std::vector<uint32_t> GetLodTriangles(const MeshLod& lod)
+		{
+			std::vector<uint32_t> triangles{};
+			for (const Meshlet& meshlet : lod.meshlets)
+			{
+				for (uint32_t corner{}; corner < meshlet.numTriangles * 3; ++corner)
+					triangles.push_back(lod.meshletVertices[meshlet.firstVertex + lod.meshletTriangles[meshlet.firstTriangle * 3 + corner]]);
+			}
+			return triangles;
+		}
+
+		void ExpectNoDegenerateTriangles(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles)
+		{
+			for (size_t triangle{}; triangle < triangles.size() / 3; ++triangle)
+			{
+				const Vector3 p0{ vertices[triangles[triangle * 3]].position };
+				const Vector3 p1{ vertices[triangles[triangle * 3 + 1]].position };
+				const Vector3 p2{ vertices[triangles[triangle * 3 + 2]].position };
+				EXPECT_GT(Vector3::Cross(p1 - p0, p2 - p0).Magnitude(), 0.f) << "triangle " << triangle;
+			}
+		}
+
+		// Every edge, between welded positions, is used exactly once in each direction
+		void ExpectClosed(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles)
+		{
+			std::map<std::array<float, 3>, uint32_t> positionIds{};
+			std::map<std::array<uint32_t, 2>, int> edgeUses{};
+			for (size_t corner{}; corner < triangles.size(); ++corner)
+			{
+				const size_t next{ corner / 3 * 3 + (corner + 1) % 3 };
+				std::array<uint32_t, 2> edge{};
+				for (int end{}; end < 2; ++end)
+				{
+					const Vector4& position{ vertices[triangles[end == 0 ? corner : next]].position };
+					edge[end] = positionIds.emplace(std::array<float, 3>{ position.x, position.y, position.z }, static_cast<uint32_t>(positionIds.size())).first->second;
+				}
+				++edgeUses[edge];
+			}
+
+			ASSERT_FALSE(edgeUses.empty());
+			for (const auto& [edge, numUses] : edgeUses)
+			{
+				EXPECT_EQ(numUses, 1) << "edge " << edge[0] << " - " << edge[1];
+				const auto reverse{ edgeUses.find({ edge[1], edge[0] }) };
+				EXPECT_TRUE(reverse != edgeUses.end() && reverse->second == 1) << "edge " << edge[0] << " - " << edge[1] << " has no opposite";
+			}
+		}
+	}
+
+	TEST(MeshSimplifier, SimplifyRespectsTargetAndKeepsSphereClosed)
+	{
+		const Mesh mesh{ CreateSphereMesh(24, 32) };
+		ExpectClosed(mesh.vertices, mesh.indices);
+		const size_t numTriangles{ mesh.indices.size() / 3 };
+
+		float previousError{};
+		for (const size_t targetTriangles : { numTriangles / 2, numTriangles / 4, numTriangles / 8, numTriangles / 16, size_t{ 40 } })
+		{
+			SCOPED_TRACE(testing::Message() << "target " << targetTriangles);
+
+			float error{ -1.f };
+			const std::vector<uint32_t> triangles{ MeshSimplifier::Simplify(mesh.vertices, mesh.indices, targetTriangles, std::numeric_limits<float>::max(), error) };
+
+			EXPECT_LE(triangles.size() / 3, targetTriangles);
+			EXPECT_GE(error, previousError);
+			previousError = error;
+
+			ExpectNoDegenerateTriangles(mesh.vertices, triangles);
+			ExpectClosed(mesh.vertices, triangles);
+		}
+
+		// Taking it down to a few dozen triangles moves the surface, but not further than the sphere is wide
+		EXPECT_GT(previousError, 0.f);
+		EXPECT_LT(previousError, 1.f);
+	}
+
+	TEST(MeshSimplifier, SimplifyKeepsNothingDegenerateOnOpenGrid)
+	{
+		const Mesh mesh{ CreateGridMesh(30, 30, [](float x, float y) { return std::sin(x * .4f) * std::cos(y * .3f) * 3.f; }) };
+
+		float error{};
+		const std::vector<uint32_t> triangles{ MeshSimplifier::Simplify(mesh.vertices, mesh.indices, 300, std::numeric_limits<float>::max(), error) };
+		EXPECT_LE(triangles.size() / 3, size_t{ 300 });
+		ExpectNoDegenerateTriangles(mesh.vertices, triangles);
+
+		// Already small enough, nothing to do
+		const std::vector<uint32_t> unchanged{ MeshSimplifier::Simplify(mesh.vertices, mesh.indices, mesh.indices.size() / 3, std::numeric_limits<float>::max(), error) };
+		EXPECT_EQ(unchanged.size(), mesh.indices.size());
+		EXPECT_EQ(error, 0.f);
+	}
+
+	TEST(MeshSimplifier, BuildLodsHalvesEveryLevel)
+	{
+		Mesh mesh{ CreateSphereMesh(24, 32) };
+		const uint32_t numTriangles{ static_cast<uint32_t>(mesh.indices.size() / 3) };
+		MeshSimplifier::BuildLods(mesh, 5);
+
+		ASSERT_GE(mesh.lods.size(), size_t{ 3 });
+		EXPECT_LE(mesh.lods.size(), size_t{ 5 });
+		EXPECT_EQ(mesh.lods.front().numTriangles, numTriangles);
+		EXPECT_EQ(mesh.lods.front().error, 0.f);
+
+		for (size_t level{}; level < mesh.lods.size(); ++level)
+		{
+			SCOPED_TRACE(testing::Message() << "level " << level);
+			const MeshLod& lod{ mesh.lods[level] };
+
+			EXPECT_LE(lod.numTriangles, numTriangles >> level);
+			if (level > 0)
+			{
+				EXPECT_LT(lod.numTriangles, mesh.lods[level - 1].numTriangles);
+				EXPECT_GE(lod.error, mesh.lods[level - 1].error);
+			}
+
+			const std::vector<uint32_t> triangles{ GetLodTriangles(lod) };
+			EXPECT_EQ(triangles.size(), static_cast<size_t>(lod.numTriangles) * 3);
+			ExpectNoDegenerateTriangles(mesh.vertices, triangles);
+			ExpectClosed(mesh.vertices, triangles);
+		}
+	}
+
+	namespace
+	{
+		// Keeps every worker thread busy until Open, so only the thread that waits can run the other jobs
+		class WorkerGate final
+		{
+		public:
+			WorkerGate()
+			{
+				JobSystem& jobSystem{ JobSystem::GetInstance() };
+				const int numWorkers{ jobSystem.GetNumThreads() - 1 };
+				for (int index{}; index < numWorkers; ++index)
+				{
+					m_Jobs.push_back(jobSystem.CreateJob([this]()
+						{
+							m_NumBlocked.fetch_add(1);
+							while (!m_IsOpen.load())
+								std::this_thread::yield();
+						}));
+					jobSystem.Submit(m_Jobs.back());
+				}
+
+				while (m_NumBlocked.load() < numWorkers)
+					std::this_thread::yield();
+			}
+
+			~WorkerGate()
+			{
+				Open();
+			}
+
+			void Open()
+			{
+				m_IsOpen.store(true);
+				for (const JobHandle& pJob : m_Jobs)
+					JobSystem::GetInstance().Wait(pJob);
+			}
+
+		private:
+			std::vector<JobHandle> m_Jobs{};
+			std::atomic<int> m_NumBlocked{};
+			std::atomic<bool> m_IsOpen{};
+		};
+	}
+
+	TEST(JobSystem, ContinuationRunsAfterItsDependencies)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		std::atomic<int> numFinished{};
+		std::vector<JobHandle> dependencies{};
+		for (int index{}; index < 8; ++index)
+		{
+			dependencies.push_back(jobSystem.CreateJob([&numFinished]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+					numFinished.fetch_add(1);
+				}));
+		}
+
+		int numFinishedBefore{ -1 };
+		const JobHandle pContinuation{ jobSystem.CreateJob([&]() { numFinishedBefore = numFinished.load(); }) };
+		for (const JobHandle& pDependency : dependencies)
+			jobSystem.AddDependency(pContinuation, pDependency);
+
+		// Submitted first, it still has to wait for the others
+		jobSystem.Submit(pContinuation);
+		for (const JobHandle& pDependency : dependencies)
+			jobSystem.Submit(pDependency);
+
+		jobSystem.Wait(pContinuation);
+		EXPECT_EQ(numFinishedBefore, 8);
+	}
+
+	TEST(JobSystem, DependencyThatAlreadyFinishedDoesNotBlock)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		const JobHandle pDependency{ jobSystem.CreateJob([]() {}) };
+		jobSystem.Submit(pDependency);
+		jobSystem.Wait(pDependency);
+
+		bool hasRun{};
+		const JobHandle pJob{ jobSystem.CreateJob([&hasRun]() { hasRun = true; }) };
+		jobSystem.AddDependency(pJob, pDependency);
+		jobSystem.Submit(pJob);
+		jobSystem.Wait(pJob);
+		EXPECT_TRUE(hasRun);
+	}
+
+	TEST(JobSystem, ParentFinishesAfterItsChildren)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		std::atomic<int> numChildrenRun{};
+		const JobHandle pParent{ jobSystem.CreateJob([]() {}) };
+		for (int index{}; index < 100; ++index)
+		{
+			jobSystem.Submit(jobSystem.CreateJob([&numChildrenRun]()
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+					numChildrenRun.fetch_add(1);
+				}, pParent));
+		}
+		jobSystem.Submit(pParent);
+
+		jobSystem.Wait(pParent);
+		EXPECT_TRUE(pParent->IsFinished());
+		EXPECT_EQ(numChildrenRun.load(), 100);
+	}
+
+	TEST(JobSystem, NestedParallelForCoversEveryIndexOnce)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		constexpr int numOuter{ 37 };
+		constexpr int numInner{ 1001 };
+		std::vector<std::atomic<int>> counts(numOuter * numInner);
+		jobSystem.ParallelFor(0, numOuter, [&](int outerFirst, int outerLast)
+			{
+				for (int outer{ outerFirst }; outer < outerLast; ++outer)
+				{
+					jobSystem.ParallelFor(0, numInner, [&](int innerFirst, int innerLast)
+						{
+							for (int inner{ innerFirst }; inner < innerLast; ++inner)
+								counts[outer * numInner + inner].fetch_add(1);
+						});
+				}
+			});
+
+		for (size_t index{}; index < counts.size(); ++index)
+			ASSERT_EQ(counts[index].load(), 1) << "index " << index;
+	}
+
+	TEST(JobSystem, WaitRunsOtherJobsOnTheWaitingThread)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+		const int outsideIndex{ jobSystem.GetNumThreads() - 1 };
+
+		WorkerGate gate{};
+
+		// Every worker is blocked, so the child only runs if Wait picks it up
+		int childThreadIndex{ -1 };
+		const JobHandle pParent{ jobSystem.CreateJob([]() {}) };
+		jobSystem.Submit(jobSystem.CreateJob([&]() { childThreadIndex = jobSystem.GetThreadIndex(); }, pParent));
+		jobSystem.Submit(pParent);
+
+		jobSystem.Wait(pParent);
+		EXPECT_EQ(childThreadIndex, outsideIndex);
+	}
+
+	TEST(JobSystem, QueueGrowsWhileWrappedAround)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+
+		// Workers steal from the front while this thread keeps pushing at the back, so the ring has wrapped when it grows
+		constexpr int numRounds{ 20 };
+		constexpr int numJobs{ 3000 };
+		for (int round{}; round < numRounds; ++round)
+		{
+			std::vector<std::atomic<int>> counts(numJobs);
+			const JobHandle pParent{ jobSystem.CreateJob([]() {}) };
+			for (int index{}; index < numJobs; ++index)
+				jobSystem.Submit(jobSystem.CreateJob([&counts, index]() { counts[index].fetch_add(1); }, pParent));
+			jobSystem.Submit(pParent);
+			jobSystem.Wait(pParent);
+
+			for (int index{}; index < numJobs; ++index)
+				ASSERT_EQ(counts[index].load(), 1) << "round " << round << ", job " << index;
+		}
+
+		// Same again without anyone stealing, this thread pops them all from the back
+		WorkerGate gate{};
+		std::vector<int> order{};
+		const JobHandle pParent{ jobSystem.CreateJob([]() {}) };
+		for (int index{}; index < numJobs; ++index)
+			jobSystem.Submit(jobSystem.CreateJob([&order, index]() { order.push_back(index); }, pParent));
+		jobSystem.Submit(pParent);
+		jobSystem.Wait(pParent);
+
+		ASSERT_EQ(order.size(), static_cast<size_t>(numJobs));
+		for (int index{}; index < numJobs; ++index)
+			ASSERT_EQ(order[index], numJobs - 1 - index);
+	}
+
+	TEST(LinearArena, BumpAllocatesAligned)
+	{
+		LinearArena arena{ 1024 };
+
+		const std::byte* pFirst{ static_cast<std::byte*>(arena.Allocate(3, 1)) };
+		const std::byte* pSecond{ static_cast<std::byte*>(arena.Allocate(16, 16)) };
+		const std::byte* pThird{ static_cast<std::byte*>(arena.Allocate(8, 64)) };
+
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(pSecond) % 16, 0u);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(pThird) % 64, 0u);
+		EXPECT_EQ(pSecond, pFirst + 16);
+		EXPECT_EQ(pThird, pFirst + 64);
+
+		const ArenaStatistics statistics{ arena.GetStatistics() };
+		EXPECT_EQ(statistics.used, 72u);
+		EXPECT_EQ(statistics.capacity, 1024u);
+		EXPECT_EQ(statistics.numOverflows, 0u);
+	}
+
+	TEST(LinearArena, OverflowRegrowsOnReset)
+	{
+		LinearArena arena{ 64 };
+
+		// Writes to every byte, so a too small block shows up under a sanitizer or debug heap
+		auto allocateFrame = [&arena]()
+			{
+				for (int index{}; index < 10; ++index)
+				{
+					std::byte* pBytes{ static_cast<std::byte*>(arena.Allocate(48, 16)) };
+					std::fill(pBytes, pBytes + 48, std::byte{ 0xcd });
+				}
+			};
+
+		allocateFrame();
+		ArenaStatistics statistics{ arena.GetStatistics() };
+		EXPECT_GT(statistics.numOverflows, 0u);
+		EXPECT_EQ(statistics.capacity, 64u);
+		EXPECT_GE(statistics.used, 480u);
+
+		// The overflow blocks go away and the block grows past the high-water mark
+		arena.Reset();
+		statistics = arena.GetStatistics();
+		EXPECT_EQ(statistics.used, 0u);
+		EXPECT_EQ(statistics.numOverflows, 0u);
+		EXPECT_GE(statistics.capacity, statistics.highWater);
+		EXPECT_GE(statistics.highWater, 480u);
+
+		// The same frame again fits without going to the heap
+		allocateFrame();
+		EXPECT_EQ(arena.GetStatistics().numOverflows, 0u);
+
+		arena.Reset();
+		EXPECT_EQ(arena.GetStatistics().capacity, statistics.capacity);
+	}
+
+	TEST(LinearArena, EmptyArenaGrowsFromNothing)
+	{
+		LinearArena arena{};
+
+		EXPECT_NE(arena.Allocate(100, 8), nullptr);
+		EXPECT_EQ(arena.GetStatistics().numOverflows, 1u);
+
+		arena.Reset();
+		EXPECT_GE(arena.GetStatistics().capacity, 100u);
+		EXPECT_NE(arena.Allocate(100, 8), nullptr);
+		EXPECT_EQ(arena.GetStatistics().numOverflows, 0u);
+	}
+
+	TEST(LinearArena, ArenaVectorKeepsItsContents)
+	{
+		LinearArena arena{ 256 };
+
+		for (int frame{}; frame < 3; ++frame)
+		{
+			// Every reallocation is a new bump allocation, the old ones are only given back by Reset
+			ArenaVector<int> values{ arena };
+			for (int index{}; index < 1000; ++index)
+				values.push_back(index * frame);
+
+			for (int index{}; index < 1000; ++index)
+				ASSERT_EQ(values[index], index * frame);
+
+			values = ArenaVector<int>{ arena };
+			arena.Reset();
+		}
+
+		EXPECT_EQ(arena.GetStatistics().numOverflows, 0u);
+	}
+
+	TEST(FrameArena, EveryThreadAllocatesFromItsOwnArena)
+	{
+		JobSystem& jobSystem{ JobSystem::GetInstance() };
+		FrameArena frameArena{ 128 };
+
+		constexpr int numItems{ 4096 };
+		std::vector<int*> items(numItems);
+		for (int frame{}; frame < 2; ++frame)
+		{
+			jobSystem.ParallelFor(0, numItems, [&](int first, int last)
+				{
+					LinearArena& arena{ frameArena.GetThreadArena() };
+					for (int index{ first }; index < last; ++index)
+					{
+						items[index] = static_cast<int*>(arena.Allocate(sizeof(int), alignof(int)));
+						*items[index] = index;
+					}
+				});
+
+			for (int index{}; index < numItems; ++index)
+				ASSERT_EQ(*items[index], index);
+
+			// Overflows count their alignment on top, as if they had been bump allocated
+			EXPECT_GE(frameArena.GetStatistics().used, numItems * sizeof(int));
+
+			// Every thread's arena grows to what that thread allocated
+			frameArena.Reset();
+			const ArenaStatistics statistics{ frameArena.GetStatistics() };
+			EXPECT_EQ(statistics.used, 0u);
+			EXPECT_EQ(statistics.numOverflows, 0u);
+			EXPECT_GE(statistics.capacity, statistics.highWater);
+		}
+	}
+
+	TEST(SpscQueue, KeepsOrderAndCapacity)
+	{
+		SpscQueue<int, 4> queue{};
+
+		int value{};
+		EXPECT_FALSE(queue.TryPop(value));
+
+		// Wraps around the ring a few times
+		for (int round{}; round < 3; ++round)
+		{
+			for (int index{}; index < 4; ++index)
+				EXPECT_TRUE(queue.TryPush(round * 4 + index));
+			EXPECT_FALSE(queue.TryPush(-1));
+
+			for (int index{}; index < 4; ++index)
+			{
+				ASSERT_TRUE(queue.TryPop(value));
+				EXPECT_EQ(value, round * 4 + index);
+			}
+			EXPECT_FALSE(queue.TryPop(value));
+		}
+	}
+
+	TEST(SpscQueue, HandsEveryValueOverBetweenThreads)
+	{
+		SpscQueue<int, 8> queue{};
+		constexpr int numValues{ 100000 };
+
+		std::thread producer{ [&queue]()
+			{
+				// Counts down to the 0 that ends the stream
+				for (int index{ numValues }; index >= 0; --index)
+				{
+					while (!queue.TryPush(index))
+						std::this_thread::yield();
+				}
+			} };
+
+		// Pop blocks while the producer is behind
+		int expected{ numValues };
+		while (const int value{ queue.Pop() })
+		{
+			// Not ASSERT, returning before the join would terminate
+			EXPECT_EQ(value, expected);
+			--expected;
+		}
+		producer.join();
+
+		EXPECT_EQ(expected, 0);
+	}
+
 }